@@ -4,7 +4,9 @@
 // Extraído diretamente do main_unico.c preservando o efeito original
 
 #include <SDL2/SDL.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <math.h>
 
@@ -110,14 +112,520 @@ static void get_anim_color(const ColorAnim* ca, float out[3]) {
     out[2] = lerp_f(ca->sb, ca->tb, e);
 }
 
+// -------------------- idle sweep kernel (scalar / SSE2 / AVX2 / Q15) --------------------
+// Cada termo do sweep tem a forma sin(kx*fx + ky*fy + ph): v0, v1, v2 e o pulse.
+// Como sin(A + B) = sinA*cosB + cosA*sinB, o frame calcula uma vez tabelas de sin/cos
+// por coluna (A = kx*fx) e por linha (B = ky*fy + ph): O(W+H) senos em vez de O(W*H).
+// Os pesos de cor (anims, accent, intensity, gain) também são combinados por frame,
+// então o kernel só faz multiply-adds por pixel.
+//
+// Pipeline inteiro (q15, q15-sse2), para CPUs sem float rápido: as tabelas são pares
+// sin/cos em Q15 tirados de uma LUT (fase em voltas Q32, sem sinf por frame), os pesos
+// viram inteiros de 16 bits e o kernel produz ARGB direto, sem float nem fcol_to_u8.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SWEEP_HAVE_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define SWEEP_TARGET_SSE2 __attribute__((target("sse2")))
+#define SWEEP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SWEEP_TARGET_SSE2
+#define SWEEP_TARGET_AVX2
+#endif
+#endif
+
+#define SWEEP_TERMS 4
+
+#define SWEEP_LUT_BITS 12
+#define SWEEP_LUT_SIZE (1 << SWEEP_LUT_BITS)
+
+// armazenamento das tabelas (cresce sob demanda, reaproveitado entre frames)
+typedef struct {
+    float* data;
+    size_t cap;   // em floats
+    Sint16* qdata; // tabelas Q15 do pipeline inteiro
+    size_t qcap;   // em Sint16
+} SweepTables;
+
+typedef struct {
+    int w, h;
+    float base[3];               // constante por canal (R,G,B)
+    float wt[3][SWEEP_TERMS];    // peso de cada termo por canal
+    const float* col_s[SWEEP_TERMS];  // sin(kx*fx), w entradas
+    const float* col_c[SWEEP_TERMS];  // cos(kx*fx)
+    const float* row_s[SWEEP_TERMS];  // sin(ky*fy + ph), h entradas
+    const float* row_c[SWEEP_TERMS];  // cos(ky*fy + ph)
+
+    // pipeline inteiro: canal = (base_q6 + soma mulhi(sin Q15, wt_q7) + 32) >> 6
+    int fixed;
+    Sint16 base_q6[3];                 // nível 0..255 em Q6
+    Sint16 wt_q7[3][SWEEP_TERMS];      // peso em Q7 do nível (mulhi por Q15 -> Q6)
+    const Sint16* col_q[SWEEP_TERMS];  // pares (sin, cos) por coluna, 2*w entradas
+    const Sint16* row_q[SWEEP_TERMS];  // pares (cos, sin) por linha, 2*h entradas
+} SweepParams;
+
+static Sint16 sweep_sin_lut[SWEEP_LUT_SIZE]; // sin em Q15, uma volta
+static int sweep_fixed = 0;                  // kernel atual usa o pipeline inteiro
+
+static void sweep_lut_init(void) {
+    for (int i = 0; i < SWEEP_LUT_SIZE; ++i)
+        sweep_sin_lut[i] = (Sint16)lrint(sin(6.283185307179586 * i / SWEEP_LUT_SIZE) * 32767.0);
+}
+
+static void sweep_tables_free(SweepTables* t) {
+    free(t->data);
+    free(t->qdata);
+    t->data = NULL;
+    t->qdata = NULL;
+    t->cap = t->qcap = 0;
+}
+
+// pares Q15 de n passos a partir de turns0 voltas, avançando turns_step por passo;
+// a fase é um acumulador Q32 (a volta completa é o overflow natural do Uint32)
+static void sweep_phase_pairs_q15(Sint16* out, int n, double turns0, double turns_step, int cos_first) {
+    const double q32 = 4294967296.0;
+    Uint32 ph = (Uint32)(Uint64)((turns0 - floor(turns0)) * q32);
+    Uint32 step = (Uint32)(Uint64)((turns_step - floor(turns_step)) * q32);
+    for (int i = 0; i < n; ++i) {
+        Sint16 sn = sweep_sin_lut[ph >> (32 - SWEEP_LUT_BITS)];
+        Sint16 cs = sweep_sin_lut[(Uint32)(ph + 0x40000000u) >> (32 - SWEEP_LUT_BITS)];
+        out[2 * i] = cos_first ? cs : sn;
+        out[2 * i + 1] = cos_first ? sn : cs;
+        ph += step;
+    }
+}
+
+static Sint16 sweep_q16_clamp(float v) {
+    long q = lrintf(v);
+    return (Sint16)(q < -32768 ? -32768 : (q > 32767 ? 32767 : q));
+}
+
+static int sweep_params_build_q15(SweepParams* p, SweepTables* tabs, const float kx[SWEEP_TERMS],
+                                  const float ky[SWEEP_TERMS], const float ph[SWEEP_TERMS]) {
+    const int w = p->w, h = p->h;
+    size_t need = (size_t)SWEEP_TERMS * 2 * ((size_t)w + (size_t)h);
+    if (need > tabs->qcap) {
+        Sint16* nd = realloc(tabs->qdata, need * sizeof(Sint16));
+        if (!nd) {
+            SDL_Log("malloc failed for sweep tables");
+            return 0;
+        }
+        tabs->qdata = nd;
+        tabs->qcap = need;
+    }
+    const double inv_2pi = 1.0 / 6.283185307179586;
+    double inv_w = 1.0 / (double)(w > 1 ? w - 1 : 1);
+    double inv_h = 1.0 / (double)(h > 1 ? h - 1 : 1);
+    Sint16* cur = tabs->qdata;
+    for (int k = 0; k < SWEEP_TERMS; ++k) {
+        Sint16* col = cur; cur += 2 * w;
+        Sint16* row = cur; cur += 2 * h;
+        sweep_phase_pairs_q15(col, w, 0.0, kx[k] * inv_2pi * inv_w, 0);
+        sweep_phase_pairs_q15(row, h, ph[k] * inv_2pi, ky[k] * inv_2pi * inv_h, 1);
+        p->col_q[k] = col;
+        p->row_q[k] = row;
+    }
+    for (int c = 0; c < 3; ++c) {
+        p->base_q6[c] = sweep_q16_clamp(p->base[c] * 255.0f * 64.0f);
+        for (int k = 0; k < SWEEP_TERMS; ++k) p->wt_q7[c][k] = sweep_q16_clamp(p->wt[c][k] * 255.0f * 128.0f);
+    }
+    return 1;
+}
+
+// monta coeficientes e tabelas do frame a partir das cores animadas e do tema atual
+static int sweep_params_build(SweepParams* p, SweepTables* tabs, int w, int h,
+                              const float animR[3], const float animG[3], const float animB[3],
+                              const float accent[3], float intensity, float gain) {
+    const float TWO_PI = 6.2831853f;
+    float kx[SWEEP_TERMS], ky[SWEEP_TERMS], ph[SWEEP_TERMS];
+
+    // v0 = 0.5 + 0.5*sin((fx + animR[0]*0.5 + fy*0.3) * 2pi + animR[1]*2.0)
+    kx[0] = TWO_PI;        ky[0] = 0.3f * TWO_PI; ph[0] = animR[0] * 0.5f * TWO_PI + animR[1] * 2.0f;
+    // v1 = 0.5 + 0.5*sin((fx*1.2 + animG[1]*0.6 + fy*0.2) * 2pi + animG[2]*1.5)
+    kx[1] = 1.2f * TWO_PI; ky[1] = 0.2f * TWO_PI; ph[1] = animG[1] * 0.6f * TWO_PI + animG[2] * 1.5f;
+    // v2 = 0.5 + 0.5*sin((fx*0.8 + animB[2]*0.4 + fy*0.1) * 2pi + animB[0]*2.2)
+    kx[2] = 0.8f * TWO_PI; ky[2] = 0.1f * TWO_PI; ph[2] = animB[2] * 0.4f * TWO_PI + animB[0] * 2.2f;
+    // pulse = (0.5 + 0.5*sin((fx + fy) * 12 + animR[0]*6)) * 0.06 * gain
+    kx[3] = 12.0f;         ky[3] = 12.0f;         ph[3] = animR[0] * 6.0f;
+
+    // c = lerp((v0*a0 + v1*a1 + v2*a2) / 3, accent, 0.18) * intensity + pulse, com v = 0.5 + 0.5*s
+    const float mix = (1.0f - 0.18f) * intensity;
+    const float pulse_w = 0.5f * 0.06f * gain;
+    for (int c = 0; c < 3; ++c) {
+        float a0 = animR[c], a1 = animG[c], a2 = animB[c];
+        p->wt[c][0] = 0.5f * a0 / 3.0f * mix;
+        p->wt[c][1] = 0.5f * a1 / 3.0f * mix;
+        p->wt[c][2] = 0.5f * a2 / 3.0f * mix;
+        p->wt[c][3] = pulse_w;
+        p->base[c] = 0.5f * (a0 + a1 + a2) / 3.0f * mix + 0.18f * accent[c] * intensity + pulse_w;
+    }
+
+    p->w = w;
+    p->h = h;
+    p->fixed = sweep_fixed;
+    if (p->fixed) return sweep_params_build_q15(p, tabs, kx, ky, ph);
+
+    size_t need = (size_t)SWEEP_TERMS * 2 * ((size_t)w + (size_t)h);
+    if (need > tabs->cap) {
+        float* nd = realloc(tabs->data, need * sizeof(float));
+        if (!nd) {
+            SDL_Log("malloc failed for sweep tables");
+            return 0;
+        }
+        tabs->data = nd;
+        tabs->cap = need;
+    }
+
+    float inv_w = 1.0f / (float)(w > 1 ? w - 1 : 1);
+    float inv_h = 1.0f / (float)(h > 1 ? h - 1 : 1);
+    float* cur = tabs->data;
+    for (int k = 0; k < SWEEP_TERMS; ++k) {
+        float* cs = cur; cur += w;
+        float* cc = cur; cur += w;
+        float* rs = cur; cur += h;
+        float* rc = cur; cur += h;
+        for (int x = 0; x < w; ++x) {
+            float a = kx[k] * ((float)x * inv_w);
+            cs[x] = sinf(a);
+            cc[x] = cosf(a);
+        }
+        for (int y = 0; y < h; ++y) {
+            float b = ky[k] * ((float)y * inv_h) + ph[k];
+            rs[y] = sinf(b);
+            rc[y] = cosf(b);
+        }
+        p->col_s[k] = cs; p->col_c[k] = cc;
+        p->row_s[k] = rs; p->row_c[k] = rc;
+    }
+    return 1;
+}
+
+// um pixel a partir das tabelas (referência e cauda dos caminhos SIMD)
+static inline Uint32 sweep_pixel(const SweepParams* p, int x, const float rs[SWEEP_TERMS], const float rc[SWEEP_TERMS]) {
+    float col[3] = { p->base[0], p->base[1], p->base[2] };
+    for (int k = 0; k < SWEEP_TERMS; ++k) {
+        float s = p->col_s[k][x] * rc[k] + p->col_c[k][x] * rs[k];
+        for (int c = 0; c < 3; ++c) col[c] += s * p->wt[c][k];
+    }
+    // ARGB8888 in memory
+    return (255u << 24) | ((Uint32)fcol_to_u8(col[0]) << 16) | ((Uint32)fcol_to_u8(col[1]) << 8) | (Uint32)fcol_to_u8(col[2]);
+}
+
+static inline void sweep_row_factors(const SweepParams* p, int y, float rs[SWEEP_TERMS], float rc[SWEEP_TERMS]) {
+    for (int k = 0; k < SWEEP_TERMS; ++k) {
+        rs[k] = p->row_s[k][y];
+        rc[k] = p->row_c[k][y];
+    }
+}
+
+typedef void (*SweepRowsFn)(const SweepParams* p, Uint32* dst, int pitch_px, int y0, int y1);
+
+static void sweep_rows_scalar(const SweepParams* p, Uint32* dst, int pitch_px, int y0, int y1) {
+    for (int y = y0; y < y1; ++y) {
+        float rs[SWEEP_TERMS], rc[SWEEP_TERMS];
+        sweep_row_factors(p, y, rs, rc);
+        Uint32* out = dst + (size_t)y * pitch_px;
+        for (int x = 0; x < p->w; ++x) out[x] = sweep_pixel(p, x, rs, rc);
+    }
+}
+
+#ifdef SWEEP_HAVE_X86
+// mesma conversão de fcol_to_u8: trunc(v*255 + 0.5) saturado em 0..255
+SWEEP_TARGET_SSE2 static inline __m128i sweep_to_u8_sse2(__m128 v) {
+    v = _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f));
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+    return _mm_cvttps_epi32(v);
+}
+
+SWEEP_TARGET_SSE2 static void sweep_rows_sse2(const SweepParams* p, Uint32* dst, int pitch_px, int y0, int y1) {
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+
+    for (int y = y0; y < y1; ++y) {
+        float rs[SWEEP_TERMS], rc[SWEEP_TERMS];
+        sweep_row_factors(p, y, rs, rc);
+        __m128 vrs[SWEEP_TERMS], vrc[SWEEP_TERMS];
+        for (int k = 0; k < SWEEP_TERMS; ++k) { vrs[k] = _mm_set1_ps(rs[k]); vrc[k] = _mm_set1_ps(rc[k]); }
+        Uint32* out = dst + (size_t)y * pitch_px;
+        int x = 0;
+        for (; x + 4 <= p->w; x += 4) {
+            __m128 s[SWEEP_TERMS];
+            for (int k = 0; k < SWEEP_TERMS; ++k)
+                s[k] = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(p->col_s[k] + x), vrc[k]),
+                                  _mm_mul_ps(_mm_loadu_ps(p->col_c[k] + x), vrs[k]));
+            __m128i ch[3];
+            for (int c = 0; c < 3; ++c) {
+                __m128 v = _mm_set1_ps(p->base[c]);
+                for (int k = 0; k < SWEEP_TERMS; ++k) v = _mm_add_ps(v, _mm_mul_ps(s[k], _mm_set1_ps(p->wt[c][k])));
+                ch[c] = sweep_to_u8_sse2(v);
+            }
+            __m128i px = _mm_or_si128(_mm_or_si128(alpha, _mm_slli_epi32(ch[0], 16)),
+                                      _mm_or_si128(_mm_slli_epi32(ch[1], 8), ch[2]));
+            _mm_storeu_si128((__m128i*)(out + x), px);
+        }
+        for (; x < p->w; ++x) out[x] = sweep_pixel(p, x, rs, rc);
+    }
+}
+
+SWEEP_TARGET_AVX2 static inline __m256i sweep_to_u8_avx2(__m256 v) {
+    v = _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f));
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+    return _mm256_cvttps_epi32(v);
+}
+
+SWEEP_TARGET_AVX2 static void sweep_rows_avx2(const SweepParams* p, Uint32* dst, int pitch_px, int y0, int y1) {
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+
+    for (int y = y0; y < y1; ++y) {
+        float rs[SWEEP_TERMS], rc[SWEEP_TERMS];
+        sweep_row_factors(p, y, rs, rc);
+        __m256 vrs[SWEEP_TERMS], vrc[SWEEP_TERMS];
+        for (int k = 0; k < SWEEP_TERMS; ++k) { vrs[k] = _mm256_set1_ps(rs[k]); vrc[k] = _mm256_set1_ps(rc[k]); }
+        Uint32* out = dst + (size_t)y * pitch_px;
+        int x = 0;
+        for (; x + 8 <= p->w; x += 8) {
+            __m256 s[SWEEP_TERMS];
+            for (int k = 0; k < SWEEP_TERMS; ++k)
+                s[k] = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(p->col_s[k] + x), vrc[k]),
+                                     _mm256_mul_ps(_mm256_loadu_ps(p->col_c[k] + x), vrs[k]));
+            __m256i ch[3];
+            for (int c = 0; c < 3; ++c) {
+                __m256 v = _mm256_set1_ps(p->base[c]);
+                for (int k = 0; k < SWEEP_TERMS; ++k) v = _mm256_add_ps(v, _mm256_mul_ps(s[k], _mm256_set1_ps(p->wt[c][k])));
+                ch[c] = sweep_to_u8_avx2(v);
+            }
+            __m256i px = _mm256_or_si256(_mm256_or_si256(alpha, _mm256_slli_epi32(ch[0], 16)),
+                                         _mm256_or_si256(_mm256_slli_epi32(ch[1], 8), ch[2]));
+            _mm256_storeu_si256((__m256i*)(out + x), px);
+        }
+        for (; x < p->w; ++x) out[x] = sweep_pixel(p, x, rs, rc);
+    }
+}
+#endif
+
+// pipeline inteiro, escalar. Mesma aritmética do q15-sse2 (bit a bit na faixa normal):
+// s = (sinA*cosB + cosA*sinB) >> 15, termo = (s * wt_q7) >> 16, canal = (soma + 32) >> 6
+static inline Uint32 sweep_pixel_q15(const SweepParams* p, int x, const Sint16* const rows[SWEEP_TERMS]) {
+    Sint32 acc[3] = { p->base_q6[0], p->base_q6[1], p->base_q6[2] };
+    for (int k = 0; k < SWEEP_TERMS; ++k) {
+        const Sint16* cp = p->col_q[k] + 2 * x;
+        Sint32 sk = ((Sint32)cp[0] * rows[k][0] + (Sint32)cp[1] * rows[k][1]) >> 15;
+        if (sk > 32767) sk = 32767;
+        if (sk < -32768) sk = -32768;
+        for (int c = 0; c < 3; ++c) acc[c] += (sk * p->wt_q7[c][k]) >> 16;
+    }
+    Uint32 px = 255u << 24;
+    for (int c = 0; c < 3; ++c) {
+        Sint32 v = (acc[c] + 32) >> 6;
+        v = v < 0 ? 0 : (v > 255 ? 255 : v);
+        px |= (Uint32)v << (16 - 8 * c);
+    }
+    return px;
+}
+
+static void sweep_rows_q15(const SweepParams* p, Uint32* dst, int pitch_px, int y0, int y1) {
+    for (int y = y0; y < y1; ++y) {
+        const Sint16* rows[SWEEP_TERMS];
+        for (int k = 0; k < SWEEP_TERMS; ++k) rows[k] = p->row_q[k] + 2 * y;
+        Uint32* out = dst + (size_t)y * pitch_px;
+        for (int x = 0; x < p->w; ++x) out[x] = sweep_pixel_q15(p, x, rows);
+    }
+}
+
+#ifdef SWEEP_HAVE_X86
+// 8 pixels por iteração: pmaddwd dá sinA*cosB + cosA*sinB direto dos pares intercalados,
+// pmulhw aplica os pesos e packus satura em 0..255
+SWEEP_TARGET_SSE2 static void sweep_rows_q15_sse2(const SweepParams* p, Uint32* dst, int pitch_px, int y0, int y1) {
+    const __m128i ff = _mm_set1_epi8((char)0xFF);
+    const __m128i round6 = _mm_set1_epi16(32);
+
+    for (int y = y0; y < y1; ++y) {
+        const Sint16* rows[SWEEP_TERMS];
+        __m128i vrow[SWEEP_TERMS];
+        for (int k = 0; k < SWEEP_TERMS; ++k) {
+            rows[k] = p->row_q[k] + 2 * y;
+            // (cosB, sinB) repetido nos 4 pares
+            vrow[k] = _mm_set1_epi32((int)(((Uint32)(Uint16)rows[k][1] << 16) | (Uint16)rows[k][0]));
+        }
+        Uint32* out = dst + (size_t)y * pitch_px;
+        int x = 0;
+        for (; x + 8 <= p->w; x += 8) {
+            __m128i sk[SWEEP_TERMS];
+            for (int k = 0; k < SWEEP_TERMS; ++k) {
+                const __m128i* cp = (const __m128i*)(p->col_q[k] + 2 * x);
+                __m128i lo = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128(cp), vrow[k]), 15);
+                __m128i hi = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128(cp + 1), vrow[k]), 15);
+                sk[k] = _mm_packs_epi32(lo, hi);
+            }
+            __m128i ch[3];
+            for (int c = 0; c < 3; ++c) {
+                __m128i acc = _mm_set1_epi16(p->base_q6[c]);
+                for (int k = 0; k < SWEEP_TERMS; ++k)
+                    acc = _mm_adds_epi16(acc, _mm_mulhi_epi16(sk[k], _mm_set1_epi16(p->wt_q7[c][k])));
+                acc = _mm_srai_epi16(_mm_adds_epi16(acc, round6), 6);
+                ch[c] = _mm_packus_epi16(acc, acc); // 8 bytes úteis
+            }
+            // ARGB8888 na memória (little-endian): B, G, R, A
+            __m128i bg = _mm_unpacklo_epi8(ch[2], ch[1]);
+            __m128i ra = _mm_unpacklo_epi8(ch[0], ff);
+            _mm_storeu_si128((__m128i*)(out + x), _mm_unpacklo_epi16(bg, ra));
+            _mm_storeu_si128((__m128i*)(out + x + 4), _mm_unpackhi_epi16(bg, ra));
+        }
+        for (; x < p->w; ++x) out[x] = sweep_pixel_q15(p, x, rows);
+    }
+}
+#endif
+
+// kernels em ordem de preferência; sweep_select_kernel(NULL) pega o primeiro suportado
+typedef struct {
+    const char* name;
+    SweepRowsFn fn;
+    int fixed;                // usa as tabelas Q15
+    SDL_bool (*supported)(void); // NULL = sempre
+} SweepKernel;
+
+static const SweepKernel sweepKernels[] = {
+#ifdef SWEEP_HAVE_X86
+    { "avx2", sweep_rows_avx2, 0, SDL_HasAVX2 },
+    { "sse2", sweep_rows_sse2, 0, SDL_HasSSE2 },
+    { "q15-sse2", sweep_rows_q15_sse2, 1, SDL_HasSSE2 },
+#endif
+    { "q15", sweep_rows_q15, 1, NULL },
+    { "scalar", sweep_rows_scalar, 0, NULL },
+};
+static const int sweepKernelCount = sizeof(sweepKernels)/sizeof(sweepKernels[0]);
+
+static SweepRowsFn sweep_rows = sweep_rows_scalar;
+static const char* sweep_kernel_name = "scalar";
+
+// name == NULL: o mais largo suportado pela CPU; retorna 0 se 'name' não existe/não roda aqui
+static int sweep_select_kernel(const char* name) {
+    static int lut_ready = 0;
+    if (!lut_ready) { sweep_lut_init(); lut_ready = 1; }
+    for (int i = 0; i < sweepKernelCount; ++i) {
+        const SweepKernel* k = &sweepKernels[i];
+        if (name && strcmp(name, k->name) != 0) continue;
+        if (k->supported && !k->supported()) continue;
+        sweep_rows = k->fn;
+        sweep_kernel_name = k->name;
+        sweep_fixed = k->fixed;
+        SDL_Log("Idle sweep kernel: %s", sweep_kernel_name);
+        return 1;
+    }
+    SDL_Log("Kernel do sweep indisponível: %s", name ? name : "(nenhum)");
+    return 0;
+}
+
+// -------------------- bench (--bench) --------------------
+// N frames offscreen (driver dummy + renderer por software), semente fixa e passo
+// fixo de 1/60 s; imprime min/mediana/p99 por fase e ns/pixel.
+
+static int bench_cmp_float(const void* a, const void* b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_report(const char* phase, float* ms, int n, long pixels) {
+    qsort(ms, (size_t)n, sizeof(float), bench_cmp_float);
+    float med = ms[n / 2];
+    printf("  %-14s min %8.3f  med %8.3f  p99 %8.3f ms", phase, ms[0], med, ms[(n - 1) * 99 / 100]);
+    if (pixels > 0) printf("  %7.3f ns/px", med * 1.0e6 / (double)pixels);
+    printf("\n");
+}
+
+static int run_bench(int frames, int w, int h, const char* kernel) {
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) { SDL_Log("SDL_Init error: %s", SDL_GetError()); return 1; }
+    if (!sweep_select_kernel(kernel)) { SDL_Quit(); return 1; }
+
+    SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer* renderer = target ? SDL_CreateSoftwareRenderer(target) : NULL;
+    SDL_Texture* texture = renderer ? SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                                        SDL_TEXTUREACCESS_STREAMING, w, h) : NULL;
+    Uint32* pixels = malloc(sizeof(Uint32) * w * h);
+    float* samples = malloc(sizeof(float) * 3 * (size_t)frames);
+    int ok = texture && pixels && samples;
+    if (!ok) SDL_Log("Bench: falha na inicialização: %s", SDL_GetError());
+
+    if (ok) {
+        float* t_sweep = samples;
+        float* t_upload = samples + frames;
+        float* t_present = samples + 2 * frames;
+        const double perf_ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+        SweepTables sweepTables = {0};
+
+        srand(1);
+        currentTheme = darkTheme;
+        init_color_anims(3.0f);
+
+        for (int f = 0; f < frames; ++f) {
+            update_color_anims(1.0f / 60.0f);
+
+            float animR[3], animG[3], animB[3];
+            get_anim_color(&colorAnims[2], animR);
+            get_anim_color(&colorAnims[1], animG);
+            get_anim_color(&colorAnims[0], animB);
+            float accent[3] = { currentTheme.accent.r, currentTheme.accent.g, currentTheme.accent.b };
+
+            Uint64 t0 = SDL_GetPerformanceCounter();
+            SweepParams sp;
+            if (sweep_params_build(&sp, &sweepTables, w, h, animR, animG, animB, accent,
+                                   currentTheme.idle_intensity, currentTheme.idle_gain)) {
+                sweep_rows(&sp, pixels, w, 0, h);
+            }
+            Uint64 t1 = SDL_GetPerformanceCounter();
+            SDL_UpdateTexture(texture, NULL, pixels, w * sizeof(Uint32));
+            Uint64 t2 = SDL_GetPerformanceCounter();
+            SDL_RenderClear(renderer);
+            SDL_RenderCopy(renderer, texture, NULL, NULL);
+            SDL_RenderPresent(renderer);
+            Uint64 t3 = SDL_GetPerformanceCounter();
+
+            t_sweep[f] = (float)((t1 - t0) * perf_ms);
+            t_upload[f] = (float)((t2 - t1) * perf_ms);
+            t_present[f] = (float)((t3 - t2) * perf_ms);
+        }
+
+        printf("bench: %d frames, %dx%d, kernel %s, driver %s\n",
+               frames, w, h, sweep_kernel_name, SDL_GetCurrentVideoDriver());
+        bench_report("sweep fill", t_sweep, frames, (long)w * h);
+        bench_report("upload", t_upload, frames, (long)w * h);
+        bench_report("present", t_present, frames, 0);
+        sweep_tables_free(&sweepTables);
+    }
+
+    free(samples);
+    free(pixels);
+    if (texture) SDL_DestroyTexture(texture);
+    if (renderer) SDL_DestroyRenderer(renderer);
+    if (target) SDL_FreeSurface(target);
+    SDL_Quit();
+    return ok ? 0 : 1;
+}
+
 // -------------------- main --------------------
 
 int main(int argc, char* argv[]) {
-    (void)argc; (void)argv;
+    int opt_bench = 0;                 // --bench N
+    int bench_w = 1280, bench_h = 720; // --size WxH
+    const char* opt_kernel = NULL;     // --kernel NAME (padrão: automático)
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) opt_bench = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) opt_kernel = argv[++i];
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &bench_w, &bench_h) != 2 || bench_w <= 0 || bench_h <= 0) {
+                SDL_Log("Tamanho inválido: %s (use WxH)", argv[i]);
+                return 1;
+            }
+        }
+    }
+    if (opt_bench > 0) return run_bench(opt_bench, bench_w, bench_h, opt_kernel);
 
     srand((unsigned)time(NULL));
 
     SDL_Init(SDL_INIT_VIDEO);
+    if (!sweep_select_kernel(opt_kernel)) sweep_select_kernel(NULL);
 
     SDL_Window* window = SDL_CreateWindow(
             "Idle Sweep RGB",
@@ -148,6 +656,8 @@ int main(int argc, char* argv[]) {
     currentTheme = darkTheme;
     init_color_anims(3.0f);
 
+    SweepTables sweepTables = {0};
+
     Uint32 last_time = SDL_GetTicks();
     int running = 1;
 
@@ -196,40 +706,12 @@ int main(int argc, char* argv[]) {
             get_anim_color(&colorAnims[2], animB);
         }
 
-        float ar = currentTheme.accent.r;
-        float ag = currentTheme.accent.g;
-        float ab = currentTheme.accent.b;
-
-        for (int y = 0; y < win_h; y++) {
-            float fy = (float)y / (float)(win_h - 1);
-            for (int x = 0; x < win_w; x++) {
-                float fx = (float)x / (float)(win_w - 1);
+        float accent[3] = { currentTheme.accent.r, currentTheme.accent.g, currentTheme.accent.b };
 
-                float v0 = 0.5f + 0.5f * sinf((fx + animR[0]*0.5f + fy*0.3f) * 6.2831853f + animR[1]*2.0f);
-                float v1 = 0.5f + 0.5f * sinf((fx*1.2f + animG[1]*0.6f + fy*0.2f) * 6.2831853f + animG[2]*1.5f);
-                float v2 = 0.5f + 0.5f * sinf((fx*0.8f + animB[2]*0.4f + fy*0.1f) * 6.2831853f + animB[0]*2.2f);
-
-                float rr = (v0 * animR[0] + v1 * animG[0] + v2 * animB[0]) / 3.0f;
-                float gg = (v0 * animR[1] + v1 * animG[1] + v2 * animB[1]) / 3.0f;
-                float bb = (v0 * animR[2] + v1 * animG[2] + v2 * animB[2]) / 3.0f;
-
-                rr = lerp_f(rr, ar, 0.18f) * currentTheme.idle_intensity;
-                gg = lerp_f(gg, ag, 0.18f) * currentTheme.idle_intensity;
-                bb = lerp_f(bb, ab, 0.18f) * currentTheme.idle_intensity;
-
-                float pulse = (0.5f + 0.5f * sinf((fx + fy) * 12.0f + animR[0]*6.0f))
-                              * 0.06f * currentTheme.idle_gain;
-
-                rr += pulse;
-                gg += pulse;
-                bb += pulse;
-
-                pixels[y * win_w + x] =
-                        (255 << 24) |
-                        (fcol_to_u8(rr) << 16) |
-                        (fcol_to_u8(gg) << 8) |
-                        (fcol_to_u8(bb));
-            }
+        SweepParams sp;
+        if (sweep_params_build(&sp, &sweepTables, win_w, win_h, animR, animG, animB, accent,
+                               currentTheme.idle_intensity, currentTheme.idle_gain)) {
+            sweep_rows(&sp, pixels, win_w, 0, win_h);
         }
 
         SDL_UpdateTexture(texture, NULL, pixels, win_w * sizeof(Uint32));
@@ -240,6 +722,7 @@ int main(int argc, char* argv[]) {
         SDL_Delay(8);
     }
 
+    sweep_tables_free(&sweepTables);
     free(pixels);
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
@@ -5,6 +5,7 @@
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -28,12 +29,18 @@ int menuSelecionado = -1; // -1 = nenhum menu aberto
 
 SDL_Rect menuBoxes[6];
 
+// layout do menu em cache: só é recalculado depois de invalidateMenuLayout()
+// (resize, fullscreen, troca de fonte, mudança de DPI/display)
+static int menuLayoutDirty = 1;
+
+static void invalidateMenuLayout(void) { menuLayoutDirty = 1; }
+
 const char* menus[] = {"Cartucho", "Tela", "Sistema", "Áudio", "Configuração", "Ajuda"};
 const int numMenus = 6;
 
-const char* dropdownItems0[] = {"Inserir Cartucho", "Ejetar", "Info", "Sair"};
+const char* dropdownItems0[] = {"Inserir Cartucho", "Biblioteca", "Ejetar", "Info", "Sair"};
 const char* dropdownItems1[] = {"Resolução", "Fullscreen", "Escala"};
-const char* dropdownItems2[] = {"Reiniciar", "Salvar Estado", "Carregar Estado"};
+const char* dropdownItems2[] = {"Reiniciar", "Salvar Estado", "Carregar Estado", "Rebobinar"};
 const char* dropdownItems3[] = {"Volume", "Mute", "Mixer"};
 const char* dropdownItems4[] = {"Vídeo", "Áudio", "Controles", "Sistema", "Tema"};
 const char* dropdownItems5[] = {"Documentação", "Sobre"};
@@ -43,6 +50,33 @@ const char** allDropdowns[] = {
         dropdownItems3, dropdownItems4, dropdownItems5
 };
 
+// ação de cada item dos dropdowns (mesma ordem dos rótulos); ACT_MODAL abre um modal com o rótulo
+typedef enum {
+    ACT_MODAL = 0,
+    ACT_CART_INSERT,
+    ACT_CART_EJECT,
+    ACT_LIBRARY,    // abre a Biblioteca e começa um rescan incremental
+    ACT_QUIT,
+    ACT_FULLSCREEN,
+    ACT_RESET,
+    ACT_SAVE_STATE,
+    ACT_LOAD_STATE,
+    ACT_VOLUME,     // hover abre a sub-box; clique não faz nada
+    ACT_MUTE
+} MenuAction;
+
+const MenuAction dropdownActions0[] = {ACT_CART_INSERT, ACT_LIBRARY, ACT_CART_EJECT, ACT_MODAL, ACT_QUIT};
+const MenuAction dropdownActions1[] = {ACT_MODAL, ACT_FULLSCREEN, ACT_MODAL};
+const MenuAction dropdownActions2[] = {ACT_RESET, ACT_SAVE_STATE, ACT_LOAD_STATE, ACT_MODAL};
+const MenuAction dropdownActions3[] = {ACT_VOLUME, ACT_MUTE, ACT_MODAL};
+const MenuAction dropdownActions4[] = {ACT_MODAL, ACT_MODAL, ACT_MODAL, ACT_MODAL, ACT_MODAL};
+const MenuAction dropdownActions5[] = {ACT_MODAL, ACT_MODAL};
+
+const MenuAction* allDropdownActions[] = {
+        dropdownActions0, dropdownActions1, dropdownActions2,
+        dropdownActions3, dropdownActions4, dropdownActions5
+};
+
 const int dropdownCounts[] = {
         sizeof(dropdownItems0)/sizeof(dropdownItems0[0]),
         sizeof(dropdownItems1)/sizeof(dropdownItems1[0]),
@@ -61,13 +95,66 @@ const int volumeCount = sizeof(volumeItems)/sizeof(volumeItems[0]);
 const char* themeOptions[] = {"Escuro", "Claro"};
 const int themeOptionsCount = sizeof(themeOptions)/sizeof(themeOptions[0]);
 
+// Tela -> Resolução: escala interna do fundo (textura menor esticada com filtro linear)
+const char* bgScaleOptions[] = {"1/1", "1/2", "1/4", "1/8"};
+const int bgScaleDivs[] = {1, 2, 4, 8};
+const int bgScaleOptionsCount = sizeof(bgScaleOptions)/sizeof(bgScaleOptions[0]);
+int bgScaleIndex = 0;
+
+// Resolução automática: orçamento (ms) para sweep + present; 0 = manual
+const char* dynResOptions[] = {"Manual", "Auto 16.6 ms", "Auto 8.3 ms"};
+const float dynResBudgets[] = {0.0f, 16.6f, 8.3f};
+const int dynResOptionsCount = sizeof(dynResOptions)/sizeof(dynResOptions[0]);
+int dynResIndex = 0;
+
+// Configuração -> Vídeo: Contínuo redesenha todo frame; Economia só redesenha com input,
+// transição de tema ou no passo da idle animation, e dorme em SDL_WaitEventTimeout no resto
+const char* renderModeOptions[] = {"Contínuo", "Economia"};
+const int renderModeOptionsCount = sizeof(renderModeOptions)/sizeof(renderModeOptions[0]);
+int renderModeIndex = 0;
+#define IDLE_ANIM_FPS 15
+
+// Configuração -> Vídeo (2ª linha): vsync no present; sem vsync o FramePacer agenda os frames
+const char* vsyncOptions[] = {"Sem VSync", "VSync"};
+const int vsyncOptionsCount = sizeof(vsyncOptions)/sizeof(vsyncOptions[0]);
+int vsyncIndex = 0;
+
+// Configuração -> Vídeo (3ª linha): sweep a cada frame ou keyframes pré-calculados
+const char* bgBakeOptions[] = {"Fundo ao vivo", "Keyframes"};
+const int bgBakeOptionsCount = sizeof(bgBakeOptions)/sizeof(bgBakeOptions[0]);
+int bgBakeIndex = 0;
+
+// Sistema -> Rebobinar: histórico para voltar no tempo (Backspace)
+const char* rewindOptions[] = {"Desligado", "Ligado"};
+const int rewindOptionsCount = sizeof(rewindOptions)/sizeof(rewindOptions[0]);
+int rewindIndex = 0;
+
+// Configuração -> Controles: run-ahead (quadros simulados além do tempo real)
+const char* runAheadOptions[] = {"Desligado", "1 quadro", "2 quadros"};
+const int runAheadOptionsCount = sizeof(runAheadOptions)/sizeof(runAheadOptions[0]);
+int runAheadIndex = 0;
+
 int volumeDropdownOpen = 0;
 int currentVolume = 100;
 int muted = 0;
 
+// conteúdo do modal, decidido uma vez pelo título em openModalWithTitle
+typedef enum {
+    MODAL_PLACEHOLDER = 0,
+    MODAL_THEME,
+    MODAL_RESOLUTION,
+    MODAL_VIDEO,
+    MODAL_CART_INSERT,
+    MODAL_CART_INFO,
+    MODAL_LIBRARY,
+    MODAL_REWIND,
+    MODAL_CONTROLS
+} ModalKind;
+
 typedef struct {
     int open;
     char title[128];
+    ModalKind kind;
     SDL_Rect rect;
     SDL_Rect closeBtn;
 } Modal;
@@ -77,13 +164,20 @@ Modal modal = {0};
 // variáveis de janela/recursos
 int win_w = DEFAULT_WIDTH;
 int win_h = DEFAULT_HEIGHT;
-SDL_Texture* texture = NULL;
-Uint32* pixels = NULL;
+// fundo: duas texturas streaming em rodízio; o sweep escreve direto na memória do SDL_LockTexture
+#define BG_TEXTURE_COUNT 2
+SDL_Texture* bgTextures[BG_TEXTURE_COUNT] = {NULL, NULL};
+int bgTextureIndex = 0; // próxima textura a ser preenchida
+int bgReadyIndex = -1; // última textura preenchida pelo sweep (-1 = nenhuma ainda)
 
 // HiDPI / drawable size
 int drawable_w = DEFAULT_WIDTH;
 int drawable_h = DEFAULT_HEIGHT;
 
+// tamanho das texturas de fundo (drawable dividido pela escala de Resolução)
+int bg_w = DEFAULT_WIDTH;
+int bg_h = DEFAULT_HEIGHT;
+
 // utilitários
 static int clamp_int(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
 
@@ -116,7 +210,9 @@ static Theme currentTheme;
 static Theme startTheme;
 static Theme targetTheme;
 static float theme_t = 1.0f; // 0..1 progress of transition
+static float theme_t_prev = 1.0f; // theme_t no passo de simulação anterior (interpolação)
 static float theme_duration = 0.0f;
+static unsigned theme_generation = 0; // incrementa a cada transição (invalida caches de cor)
 
 static inline float lerp_f(float a, float b, float t) { return a + (b - a) * t; }
 static inline float smoothstep_f_local(float t) {
@@ -149,6 +245,45 @@ static void startThemeTransition(const Theme* newTheme, float duration_seconds)
     targetTheme = *newTheme;
     theme_duration = duration_seconds > 0.0f ? duration_seconds : 0.45f;
     theme_t = 0.0f;
+    theme_t_prev = 0.0f; // começa do início, sem interpolar a partir da transição anterior
+    theme_generation++;
+}
+
+static void initThemes(void) {
+    // THEME: inicializar temas (darkTheme = tema atual; lightTheme = tema claro suave)
+    // Valores sugeridos (0..1 floats)
+    darkTheme = (Theme){
+            .name = "Dark Default",
+            .background = {0.06f,0.07f,0.08f,1.0f}, // #0f1113
+            .panel = {0.11f,0.11f,0.13f,1.0f},      // #1b1d20
+            .accent = {0.43f,0.70f,1.0f,1.0f},      // #6fb3ff
+            .text = {0.90f,0.93f,0.96f,1.0f},       // #e6eef6
+            .mutedText = {0.60f,0.66f,0.70f,1.0f},  // #9aa6b2
+            .menuBg = {0.08f,0.09f,0.10f,1.0f},
+            .menuHover = {0.16f,0.17f,0.18f,1.0f},
+            .idle_gain = 1.6f,
+            .idle_intensity = 0.7f
+    };
+
+    lightTheme = (Theme){
+            .name = "Light Soft",
+            .background = {0.96f,0.97f,0.97f,1.0f}, // #f5f7f8
+            .panel = {1.0f,1.0f,1.0f,1.0f},         // #ffffff
+            .accent = {0.23f,0.51f,0.77f,1.0f},     // #3b82c4
+            .text = {0.06f,0.09f,0.13f,1.0f},       // #0f1720
+            .mutedText = {0.36f,0.42f,0.45f,1.0f},  // #5b6b73
+            .menuBg = {1.0f,1.0f,1.0f,1.0f},
+            .menuHover = {0.90f,0.94f,0.96f,1.0f},
+            .idle_gain = 3.0f,
+            .idle_intensity = 1.0f
+    };
+
+    // start with dark theme
+    currentTheme = darkTheme;
+    targetTheme = darkTheme;
+    startTheme = darkTheme;
+    theme_t = 1.0f;
+    theme_duration = 0.0f;
 }
 
 // helper para converter FColor (0..1) para Uint8
@@ -159,12 +294,19 @@ static Uint8 fcol_to_u8(float v) {
     return (Uint8)iv;
 }
 
-// recria texture e buffer usando tamanho drawable (HiDPI aware)
-int recreateTextureAndBufferFromWindow(SDL_Window* window, SDL_Renderer* renderer) {
-    if (!window || !renderer) return 0;
+static void destroyBackgroundTextures(void) {
+    for (int i = 0; i < BG_TEXTURE_COUNT; ++i) {
+        if (bgTextures[i]) { SDL_DestroyTexture(bgTextures[i]); bgTextures[i] = NULL; }
+    }
+}
+
+// recria as texturas de fundo usando tamanho drawable (HiDPI aware)
+// window == NULL (bench offscreen): mantém win_w/win_h já definidos
+int recreateBackgroundTextures(SDL_Window* window, SDL_Renderer* renderer) {
+    if (!renderer) return 0;
 
     // obter tamanho da janela (UI coords) e tamanho do drawable (pixels)
-    SDL_GetWindowSize(window, &win_w, &win_h);
+    if (window) SDL_GetWindowSize(window, &win_w, &win_h);
     if (SDL_GetRendererOutputSize(renderer, &drawable_w, &drawable_h) != 0) {
         // fallback: use window size
         drawable_w = win_w;
@@ -173,29 +315,783 @@ int recreateTextureAndBufferFromWindow(SDL_Window* window, SDL_Renderer* rendere
 
     if (drawable_w <= 0 || drawable_h <= 0) return 0;
 
-    if (texture) { SDL_DestroyTexture(texture); texture = NULL; }
-    if (pixels) { free(pixels); pixels = NULL; }
+    destroyBackgroundTextures();
+    bgTextureIndex = 0;
+    bgReadyIndex = -1;
+    invalidateMenuLayout(); // win_w/drawable (DPI) podem ter mudado
+
+    int div = bgScaleDivs[bgScaleIndex];
+    bg_w = drawable_w / div; if (bg_w < 1) bg_w = 1;
+    bg_h = drawable_h / div; if (bg_h < 1) bg_h = 1;
+
+    for (int i = 0; i < BG_TEXTURE_COUNT; ++i) {
+        bgTextures[i] = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, bg_w, bg_h);
+        if (!bgTextures[i]) {
+            SDL_Log("CreateTexture failed: %s", SDL_GetError());
+            destroyBackgroundTextures();
+            return 0;
+        }
+        // o sweep é de baixa frequência: esticar com filtro linear não aparece
+        SDL_SetTextureScaleMode(bgTextures[i], SDL_ScaleModeLinear);
+    }
+
+    return 1;
+}
+
+// -------------------- dynamic resolution --------------------
+// Ajusta bgScaleIndex para manter sweep + present dentro do orçamento do modo Auto.
+// Desce logo que o custo passa do limite alto por alguns frames; só sobe quando a
+// estimativa na escala maior (4x os pixels do sweep) cabe com folga por bem mais tempo.
+
+#define DYNRES_DOWN_FRAMES 8
+#define DYNRES_UP_FRAMES 45
+#define DYNRES_COOLDOWN_FRAMES 30
+
+typedef struct {
+    float sweep_ms;     // médias móveis (EWMA)
+    float present_ms;
+    int frames_over;    // frames seguidos acima do limite alto
+    int frames_under;   // frames seguidos com folga para subir
+    int cooldown;       // frames ignorados depois de uma troca (recriação, caches frios)
+} DynResController;
+
+static void dynres_reset(DynResController* dr) {
+    memset(dr, 0, sizeof(*dr));
+    dr->cooldown = DYNRES_COOLDOWN_FRAMES;
+}
+
+// retorna 1 se bgScaleIndex mudou (texturas precisam ser recriadas)
+static int dynres_update(DynResController* dr, float budget_ms, float sweep_ms, float present_ms) {
+    if (budget_ms <= 0.0f) return 0;
+    if (dr->cooldown > 0) {
+        dr->cooldown--;
+        dr->sweep_ms = sweep_ms;
+        dr->present_ms = present_ms;
+        return 0;
+    }
+    const float k = 0.1f;
+    dr->sweep_ms += (sweep_ms - dr->sweep_ms) * k;
+    dr->present_ms += (present_ms - dr->present_ms) * k;
+
+    float cost = dr->sweep_ms + dr->present_ms;
+    float cost_up = dr->sweep_ms * 4.0f + dr->present_ms;
+    dr->frames_over = cost > budget_ms * 0.9f ? dr->frames_over + 1 : 0;
+    dr->frames_under = cost_up < budget_ms * 0.6f ? dr->frames_under + 1 : 0;
+
+    int idx = bgScaleIndex;
+    if (dr->frames_over >= DYNRES_DOWN_FRAMES && idx < bgScaleOptionsCount - 1) idx++;
+    else if (dr->frames_under >= DYNRES_UP_FRAMES && idx > 0) idx--;
+    if (idx == bgScaleIndex) return 0;
+
+    SDL_Log("Resolução automática: %s -> %s (sweep %.2f ms, present %.2f ms, orçamento %.1f ms)",
+            bgScaleOptions[bgScaleIndex], bgScaleOptions[idx], dr->sweep_ms, dr->present_ms, budget_ms);
+    bgScaleIndex = idx;
+    dynres_reset(dr);
+    return 1;
+}
+
+// -------------------- frame pacing --------------------
+// Os frames seguem deadlines fixos no período do monitor em vez de "render + 8 ms".
+// Dorme com SDL_Delay até PACER_SPIN_MS antes do deadline (SDL_Delay pode acordar
+// atrasado) e termina girando no contador de alta resolução. Com vsync o present
+// já espera o retrace e o pacer não é usado.
+
+#define PACER_SPIN_MS 2.0
+#define PACER_DEFAULT_HZ 60
+
+typedef struct {
+    Uint64 freq;
+    Uint64 period;      // ticks do contador por frame
+    Uint64 deadline;    // próximo present (0 = ressincronizar)
+    int refresh_hz;
+} FramePacer;
+
+static void frame_pacer_set_rate(FramePacer* fp, int hz) {
+    if (hz <= 0) hz = PACER_DEFAULT_HZ;
+    fp->freq = SDL_GetPerformanceFrequency();
+    fp->period = fp->freq / (Uint64)hz;
+    fp->deadline = 0;
+    fp->refresh_hz = hz;
+}
+
+// taxa do monitor onde a janela está (refresh_rate 0 = desconhecida -> 60 Hz)
+static void frame_pacer_from_display(FramePacer* fp, SDL_Window* window) {
+    SDL_DisplayMode mode;
+    int hz = 0;
+    int display = SDL_GetWindowDisplayIndex(window);
+    if (display >= 0 && SDL_GetCurrentDisplayMode(display, &mode) == 0) hz = mode.refresh_rate;
+    if (hz <= 0) hz = PACER_DEFAULT_HZ;
+    if (hz == fp->refresh_hz) return;
+    frame_pacer_set_rate(fp, hz);
+    SDL_Log("Frame pacing: %d Hz", hz);
+}
+
+// espera até o deadline do frame atual. Se o frame chegou mais de um período atrasado,
+// apresenta já e realinha a partir de agora em vez de recuperar com uma rajada de frames.
+static void frame_pacer_wait(FramePacer* fp) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (fp->deadline == 0 || now >= fp->deadline + fp->period) {
+        fp->deadline = now + fp->period;
+        return;
+    }
+    Uint64 spin = (Uint64)((double)fp->freq * PACER_SPIN_MS / 1000.0);
+    if (fp->deadline > now + spin) {
+        Uint32 ms = (Uint32)((fp->deadline - now - spin) * 1000 / fp->freq);
+        if (ms > 0) SDL_Delay(ms);
+    }
+    while (SDL_GetPerformanceCounter() < fp->deadline) {
+        // spin: os últimos ~2 ms não confiam no scheduler
+    }
+    fp->deadline += fp->period;
+}
+
+// -------------------- glyph atlas --------------------
+// Cada glifo da fonte é rasterizado uma vez (branco, anti-aliased) e empacotado em
+// prateleiras numa única textura; strings viram uma sequência de SDL_RenderCopy com
+// SDL_SetTextureColorMod, sem TTF_Render* nem criação de textura por frame.
+// ASCII e Latin-1 são rasterizados na criação; outros codepoints entram sob demanda.
+
+#define GLYPH_ATLAS_SIZE 512
+#define GLYPH_ATLAS_MAX 512
+
+typedef struct {
+    Uint16 cp;
+    SDL_Rect src;       // região no atlas (w == 0: glifo sem pixels, ex.: espaço)
+    int xoff;           // deslocamento ao desenhar (minx negativo)
+    int advance;
+} AtlasGlyph;
+
+typedef struct {
+    TTF_Font* font;
+    SDL_Texture* texture;
+    int pt_size;                // tamanho com que a fonte foi aberta
+    int height;                 // TTF_FontHeight: altura de uma linha de texto
+    int pen_x, pen_y, row_h;    // empacotamento em prateleiras
+    int count;
+    int full_logged;
+    AtlasGlyph glyphs[GLYPH_ATLAS_MAX];
+    short latin1[256];          // cp < 256 -> índice em glyphs (-1 = ainda não rasterizado)
+} GlyphAtlas;
+
+// métricas memorizadas por string: layout e centralização não chamam a fonte
+// nos frames estáveis (tabela de mapeamento direto; colisão sobrescreve)
+#define TEXT_METRICS_SLOTS 128
+#define TEXT_METRICS_MAX_LEN 48
+
+typedef struct {
+    const GlyphAtlas* atlas;    // NULL = slot vazio
+    Uint32 hash;
+    int w, h;
+    char text[TEXT_METRICS_MAX_LEN];
+} TextMetric;
+
+static TextMetric textMetrics[TEXT_METRICS_SLOTS];
+
+static void text_metrics_clear(void) {
+    memset(textMetrics, 0, sizeof(textMetrics));
+}
+
+// decodifica o próximo codepoint UTF-8 e avança *s (sequência inválida -> '?')
+static Uint32 utf8_next(const char** s) {
+    const unsigned char* p = (const unsigned char*)*s;
+    Uint32 cp = p[0];
+    int len = 1;
+    if (cp >= 0xF0 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80 && (p[3] & 0xC0) == 0x80) {
+        cp = ((cp & 0x07) << 18) | ((p[1] & 0x3Fu) << 12) | ((p[2] & 0x3Fu) << 6) | (p[3] & 0x3Fu); len = 4;
+    } else if (cp >= 0xE0 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80) {
+        cp = ((cp & 0x0F) << 12) | ((p[1] & 0x3Fu) << 6) | (p[2] & 0x3Fu); len = 3;
+    } else if (cp >= 0xC0 && (p[1] & 0xC0) == 0x80) {
+        cp = ((cp & 0x1F) << 6) | (p[1] & 0x3Fu); len = 2;
+    } else if (cp >= 0x80) {
+        cp = '?';
+    }
+    *s += len;
+    return cp;
+}
+
+static int text_raster_count = 0; // chamadas TTF_Render* desde o último frame (HUD)
+
+static const AtlasGlyph* glyph_atlas_add(GlyphAtlas* a, Uint16 cp) {
+    if (a->count >= GLYPH_ATLAS_MAX) return NULL;
+    AtlasGlyph* g = &a->glyphs[a->count];
+    memset(g, 0, sizeof(*g));
+    g->cp = cp;
+
+    int minx = 0, maxx = 0, miny = 0, maxy = 0, advance = 0;
+    if (!TTF_GlyphIsProvided(a->font, cp) || TTF_GlyphMetrics(a->font, cp, &minx, &maxx, &miny, &maxy, &advance) != 0) return NULL;
+    g->advance = advance;
+    g->xoff = minx < 0 ? minx : 0;
+
+    SDL_Color white = {255, 255, 255, 255};
+    SDL_Surface* s = TTF_RenderGlyph_Blended(a->font, cp, white);
+    text_raster_count++;
+    SDL_Surface* conv = s ? SDL_ConvertSurfaceFormat(s, SDL_PIXELFORMAT_ARGB8888, 0) : NULL;
+    if (s) SDL_FreeSurface(s);
+    if (conv && conv->w > 0 && conv->h > 0) {
+        if (a->pen_x + conv->w > GLYPH_ATLAS_SIZE) {
+            a->pen_x = 0;
+            a->pen_y += a->row_h + 1;
+            a->row_h = 0;
+        }
+        if (a->pen_y + conv->h > GLYPH_ATLAS_SIZE || conv->w > GLYPH_ATLAS_SIZE) {
+            if (!a->full_logged) SDL_Log("Glyph atlas cheio (%d glifos)", a->count);
+            a->full_logged = 1;
+            SDL_FreeSurface(conv);
+            return NULL;
+        }
+        g->src.x = a->pen_x;
+        g->src.y = a->pen_y;
+        g->src.w = conv->w;
+        g->src.h = conv->h;
+        SDL_UpdateTexture(a->texture, &g->src, conv->pixels, conv->pitch);
+        a->pen_x += conv->w + 1;
+        if (conv->h > a->row_h) a->row_h = conv->h;
+    }
+    if (conv) SDL_FreeSurface(conv);
+
+    if (cp < 256) a->latin1[cp] = (short)a->count;
+    a->count++;
+    return g;
+}
+
+static const AtlasGlyph* glyph_atlas_get(GlyphAtlas* a, Uint32 cp) {
+    if (cp > 0xFFFF) cp = '?';
+    if (cp < 256) {
+        if (a->latin1[cp] >= 0) return &a->glyphs[a->latin1[cp]];
+    } else {
+        for (int i = 0; i < a->count; ++i) if (a->glyphs[i].cp == cp) return &a->glyphs[i];
+    }
+    return glyph_atlas_add(a, (Uint16)cp);
+}
 
-    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, drawable_w, drawable_h);
-    if (!texture) {
-        SDL_Log("CreateTexture failed: %s", SDL_GetError());
+static int glyph_atlas_init(GlyphAtlas* a, SDL_Renderer* renderer, TTF_Font* font, int pt_size) {
+    memset(a, 0, sizeof(*a));
+    for (int i = 0; i < 256; ++i) a->latin1[i] = -1;
+    a->font = font;
+    a->pt_size = pt_size;
+    text_metrics_clear(); // fonte nova: métricas e layout antigos não valem mais
+    invalidateMenuLayout();
+    a->height = TTF_FontHeight(font);
+    a->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, GLYPH_ATLAS_SIZE, GLYPH_ATLAS_SIZE);
+    if (!a->texture) {
+        SDL_Log("CreateTexture failed for glyph atlas: %s", SDL_GetError());
         return 0;
     }
+    // começa transparente: regiões livres nunca são amostradas, mas evita lixo no debug
+    Uint32* clear = calloc((size_t)GLYPH_ATLAS_SIZE * GLYPH_ATLAS_SIZE, sizeof(Uint32));
+    if (clear) {
+        SDL_UpdateTexture(a->texture, NULL, clear, GLYPH_ATLAS_SIZE * sizeof(Uint32));
+        free(clear);
+    }
+    SDL_SetTextureBlendMode(a->texture, SDL_BLENDMODE_BLEND);
+
+    for (Uint32 cp = 32; cp < 127; ++cp) glyph_atlas_get(a, cp);
+    for (Uint32 cp = 160; cp < 256; ++cp) glyph_atlas_get(a, cp);
+    return 1;
+}
+
+static void glyph_atlas_destroy(GlyphAtlas* a) {
+    if (a->texture) SDL_DestroyTexture(a->texture);
+    a->texture = NULL;
+    a->count = 0;
+}
+
+// atlas da fonte da UI (fonts/arial.ttf, 18)
+static GlyphAtlas uiAtlas;
+
+// largura/altura do texto como TTF_SizeUTF8, a partir das métricas guardadas
+static void glyph_atlas_measure(GlyphAtlas* a, const char* text, int* w, int* h) {
+    int pen = 0, right = 0;
+    Uint32 prev = 0;
+    while (*text) {
+        Uint32 cp = utf8_next(&text);
+        const AtlasGlyph* g = glyph_atlas_get(a, cp);
+        if (!g) continue;
+        if (prev) pen += TTF_GetFontKerningSizeGlyphs(a->font, (Uint16)prev, g->cp);
+        int extent = pen + g->xoff + g->src.w;
+        if (extent > right) right = extent;
+        pen += g->advance;
+        prev = g->cp;
+    }
+    if (w) *w = pen > right ? pen : right;
+    if (h) *h = a->height;
+}
+
+// largura/altura via textMetrics (mede pelo atlas só na primeira vez)
+static void measureText(GlyphAtlas* a, const char* text, int* w, int* h) {
+    size_t len = strlen(text);
+    if (len >= TEXT_METRICS_MAX_LEN) { glyph_atlas_measure(a, text, w, h); return; }
+    Uint32 hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; ++i) { hash ^= (unsigned char)text[i]; hash *= 16777619u; }
+    TextMetric* m = &textMetrics[hash % TEXT_METRICS_SLOTS];
+    if (m->atlas != a || m->hash != hash || strcmp(m->text, text) != 0) {
+        m->atlas = a;
+        m->hash = hash;
+        memcpy(m->text, text, len + 1);
+        glyph_atlas_measure(a, text, &m->w, &m->h);
+    }
+    if (w) *w = m->w;
+    if (h) *h = m->h;
+}
+
+// -------------------- text texture cache --------------------
+// Strings inteiras compostas uma vez numa textura, chaveadas por (texto, fonte,
+// tamanho, cor) e despejadas em ordem LRU quando passam
+// de TEXT_CACHE_MAX_BYTES. Cores de tema mudam a cada frame numa transição: nesse
+// intervalo drawText usa o atlas, e a troca de theme_generation esvazia o cache.
+// A composição segue o mesmo layout de drawTextGlyphs/glyph_atlas_measure (avanço,
+// kerning, xoff): medir e centralizar valem para os dois caminhos, e a troca de
+// caminho no fim de uma transição não desloca o texto.
+
+#define TEXT_CACHE_BUCKETS 256
+#define TEXT_CACHE_MAX_BYTES (4 * 1024 * 1024)
+
+typedef struct TextCacheEntry {
+    struct TextCacheEntry* hnext;   // cadeia do bucket
+    struct TextCacheEntry* prev;    // lista LRU (head = usado mais recentemente)
+    struct TextCacheEntry* next;
+    Uint32 hash;
+    TTF_Font* font;
+    int pt_size;
+    SDL_Color color;
+    SDL_Texture* texture;
+    int w, h;
+    size_t bytes;
+    char text[];
+} TextCacheEntry;
+
+typedef struct {
+    TextCacheEntry* buckets[TEXT_CACHE_BUCKETS];
+    TextCacheEntry* head;
+    TextCacheEntry* tail;
+    size_t bytes;
+    int count;
+    unsigned generation;    // theme_generation das entradas atuais
+} TextCache;
+
+static TextCache uiTextCache;
+
+static Uint32 text_cache_hash(const char* text, TTF_Font* font, int pt_size, SDL_Color c) {
+    Uint32 h = 2166136261u; // FNV-1a
+    for (const unsigned char* p = (const unsigned char*)text; *p; ++p) { h ^= *p; h *= 16777619u; }
+    uintptr_t f = (uintptr_t)font;
+    Uint32 extra[3] = { (Uint32)f, (Uint32)pt_size, ((Uint32)c.r << 24) | ((Uint32)c.g << 16) | ((Uint32)c.b << 8) | c.a };
+    for (int i = 0; i < 3; ++i) { h ^= extra[i]; h *= 16777619u; }
+    return h;
+}
+
+static void text_cache_lru_unlink(TextCache* c, TextCacheEntry* e) {
+    if (e->prev) e->prev->next = e->next; else c->head = e->next;
+    if (e->next) e->next->prev = e->prev; else c->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void text_cache_lru_push_front(TextCache* c, TextCacheEntry* e) {
+    e->prev = NULL;
+    e->next = c->head;
+    if (c->head) c->head->prev = e;
+    c->head = e;
+    if (!c->tail) c->tail = e;
+}
+
+static void text_cache_remove(TextCache* c, TextCacheEntry* e) {
+    TextCacheEntry** link = &c->buckets[e->hash % TEXT_CACHE_BUCKETS];
+    while (*link && *link != e) link = &(*link)->hnext;
+    if (*link) *link = e->hnext;
+    text_cache_lru_unlink(c, e);
+    c->bytes -= e->bytes;
+    c->count--;
+    if (e->texture) SDL_DestroyTexture(e->texture);
+    free(e);
+}
+
+static void text_cache_clear(TextCache* c) {
+    while (c->head) text_cache_remove(c, c->head);
+}
+
+// superfície w x a->height com o texto no layout do atlas: cada glifo é rasterizado
+// em branco e composto (alfa "over", cor fixa) onde drawTextGlyphs o copiaria
+static SDL_Surface* text_layout_surface(GlyphAtlas* a, const char* text, SDL_Color color) {
+    int w = 0;
+    glyph_atlas_measure(a, text, &w, NULL);
+    if (w <= 0 || a->height <= 0) return NULL;
+    SDL_Surface* out = SDL_CreateRGBSurfaceWithFormat(0, w, a->height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!out) return NULL;
+    Uint32 rgb = ((Uint32)color.r << 16) | ((Uint32)color.g << 8) | color.b;
+    for (int y = 0; y < out->h; ++y) {
+        Uint32* row = (Uint32*)((Uint8*)out->pixels + (size_t)y * out->pitch);
+        for (int x = 0; x < out->w; ++x) row[x] = rgb;
+    }
+
+    SDL_Color white = {255, 255, 255, 255};
+    int pen = 0;
+    Uint32 prev = 0;
+    while (*text) {
+        Uint32 cp = utf8_next(&text);
+        const AtlasGlyph* g = glyph_atlas_get(a, cp);
+        if (!g) continue;
+        if (prev) pen += TTF_GetFontKerningSizeGlyphs(a->font, (Uint16)prev, g->cp);
+        if (g->src.w > 0) {
+            SDL_Surface* s = TTF_RenderGlyph_Blended(a->font, g->cp, white);
+            text_raster_count++;
+            SDL_Surface* conv = s ? SDL_ConvertSurfaceFormat(s, SDL_PIXELFORMAT_ARGB8888, 0) : NULL;
+            if (s) SDL_FreeSurface(s);
+            if (conv) {
+                int gx = pen + g->xoff;
+                for (int y = 0; y < conv->h && y < out->h; ++y) {
+                    const Uint32* src = (const Uint32*)((const Uint8*)conv->pixels + (size_t)y * conv->pitch);
+                    Uint32* dst = (Uint32*)((Uint8*)out->pixels + (size_t)y * out->pitch);
+                    for (int x = 0; x < conv->w; ++x) {
+                        int ox = gx + x;
+                        if (ox < 0 || ox >= out->w) continue;
+                        Uint32 sa = (src[x] >> 24) * color.a / 255;
+                        Uint32 da = dst[ox] >> 24;
+                        dst[ox] = ((sa + da * (255 - sa) / 255) << 24) | rgb;
+                    }
+                }
+                SDL_FreeSurface(conv);
+            }
+        }
+        pen += g->advance;
+        prev = g->cp;
+    }
+    return out;
+}
+
+// entrada para o texto (compõe e insere se faltar); NULL se não der para cachear
+static const TextCacheEntry* text_cache_get(TextCache* c, SDL_Renderer* renderer, GlyphAtlas* a,
+                                            const char* text, SDL_Color color) {
+    TTF_Font* font = a->font;
+    int pt_size = a->pt_size;
+    if (c->generation != theme_generation) {
+        text_cache_clear(c);
+        c->generation = theme_generation;
+    }
+
+    Uint32 hash = text_cache_hash(text, font, pt_size, color);
+    for (TextCacheEntry* e = c->buckets[hash % TEXT_CACHE_BUCKETS]; e; e = e->hnext) {
+        if (e->hash == hash && e->font == font && e->pt_size == pt_size &&
+            e->color.r == color.r && e->color.g == color.g && e->color.b == color.b && e->color.a == color.a &&
+            strcmp(e->text, text) == 0) {
+            text_cache_lru_unlink(c, e);
+            text_cache_lru_push_front(c, e);
+            return e;
+        }
+    }
+
+    SDL_Surface* s = text_layout_surface(a, text, color);
+    if (!s) return NULL;
+    size_t bytes = (size_t)s->w * (size_t)s->h * 4;
+    if (bytes > TEXT_CACHE_MAX_BYTES) { SDL_FreeSurface(s); return NULL; }
+    SDL_Texture* t = SDL_CreateTextureFromSurface(renderer, s);
+    if (t) SDL_SetTextureBlendMode(t, SDL_BLENDMODE_BLEND);
+    int w = s->w, h = s->h;
+    SDL_FreeSurface(s);
+    if (!t) {
+        SDL_Log("CreateTextureFromSurface failed: %s", SDL_GetError());
+        return NULL;
+    }
+
+    size_t len = strlen(text);
+    TextCacheEntry* e = malloc(sizeof(TextCacheEntry) + len + 1);
+    if (!e) { SDL_DestroyTexture(t); return NULL; }
+    memcpy(e->text, text, len + 1);
+    e->hash = hash;
+    e->font = font;
+    e->pt_size = pt_size;
+    e->color = color;
+    e->texture = t;
+    e->w = w;
+    e->h = h;
+    e->bytes = bytes;
+
+    while (c->tail && c->bytes + bytes > TEXT_CACHE_MAX_BYTES) text_cache_remove(c, c->tail);
+    e->hnext = c->buckets[hash % TEXT_CACHE_BUCKETS];
+    c->buckets[hash % TEXT_CACHE_BUCKETS] = e;
+    text_cache_lru_push_front(c, e);
+    c->bytes += bytes;
+    c->count++;
+    return e;
+}
+
+// glifo a glifo pelo atlas: nunca rasteriza nem cria textura (usado também pelo HUD)
+static void drawTextGlyphs(SDL_Renderer* renderer, GlyphAtlas* a, const char* text, int x, int y, SDL_Color color) {
+    if (!text || !a->texture) return;
+    SDL_SetTextureColorMod(a->texture, color.r, color.g, color.b);
+    SDL_SetTextureAlphaMod(a->texture, color.a);
+    int pen = x;
+    Uint32 prev = 0;
+    while (*text) {
+        Uint32 cp = utf8_next(&text);
+        const AtlasGlyph* g = glyph_atlas_get(a, cp);
+        if (!g) continue;
+        if (prev) pen += TTF_GetFontKerningSizeGlyphs(a->font, (Uint16)prev, g->cp);
+        if (g->src.w > 0) {
+            SDL_Rect dst = { pen + g->xoff, y, g->src.w, g->src.h };
+            SDL_RenderCopy(renderer, a->texture, &g->src, &dst);
+        }
+        pen += g->advance;
+        prev = g->cp;
+    }
+}
+
+// desenha o texto com canto superior esquerdo em (x,y): fora de transição de tema a string
+// inteira sai do cache (uma cópia); durante a transição, glifo a glifo pelo atlas; os
+// dois caminhos têm o mesmo layout, então measureText vale para ambos
+static void drawText(SDL_Renderer* renderer, GlyphAtlas* a, const char* text, int x, int y, SDL_Color color) {
+    if (!text || !*text) return;
+    if (theme_t >= 1.0f) {
+        const TextCacheEntry* e = text_cache_get(&uiTextCache, renderer, a, text, color);
+        if (e) {
+            SDL_Rect dst = { x, y, e->w, e->h };
+            SDL_RenderCopy(renderer, e->texture, NULL, &dst);
+            return;
+        }
+    }
+    drawTextGlyphs(renderer, a, text, x, y, color);
+}
+
+// -------------------- cartucho (ROM mapeada em memória) --------------------
+// A imagem (.nds, 64-512 MB) é mapeada só leitura em vez de copiada para o heap: o
+// kernel traz as páginas sob demanda e elas não contam em dobro no resident set.
+// Cabeçalho e ícone/banner só são lidos quando alguém pede (modal Info); inserir
+// não toca no resto da ROM. Ejetar desfaz o mapeamento.
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CART_HEADER_SIZE 0x200
+#define CART_BANNER_SIZE 0x840          // versão 1: ícone + paleta + 6 títulos
+#define CART_PREFETCH (4u * 1024 * 1024) // MADV_WILLNEED: cabeçalho + área de boot
+
+// arquivo inteiro mapeado só leitura (ROMs, save states)
+typedef struct {
+    const Uint8* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#else
+    int fd;
+#endif
+} MappedFile;
+
+static void file_unmap(MappedFile* m) {
+    if (m->data) {
+#ifdef _WIN32
+        UnmapViewOfFile(m->data);
+        CloseHandle(m->mapping);
+        CloseHandle(m->file);
+#else
+        munmap((void*)m->data, m->size);
+        close(m->fd);
+#endif
+    }
+    memset(m, 0, sizeof(*m));
+}
 
-    pixels = malloc(sizeof(Uint32) * drawable_w * drawable_h);
-    if (!pixels) {
-        SDL_Log("malloc failed for pixels");
-        SDL_DestroyTexture(texture);
-        texture = NULL;
+// mapeia 'path' (pelo menos min_size bytes); os primeiros 'prefetch' bytes são pedidos
+// já, o resto vem sob demanda. 0 = falhou (com log)
+static int file_map(MappedFile* m, const char* path, size_t min_size, size_t prefetch) {
+    memset(m, 0, sizeof(*m));
+#ifdef _WIN32
+    m->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    LARGE_INTEGER sz;
+    if (m->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m->file, &sz)) {
+        SDL_Log("Não foi possível abrir %s", path);
+        if (m->file != INVALID_HANDLE_VALUE) CloseHandle(m->file);
+        memset(m, 0, sizeof(*m));
+        return 0;
+    }
+    m->size = (size_t)sz.QuadPart;
+    m->mapping = m->size >= min_size && m->size > 0 ? CreateFileMappingA(m->file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    m->data = m->mapping ? (const Uint8*)MapViewOfFile(m->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!m->data) {
+        SDL_Log("Falha ao mapear %s (%zu bytes)", path, m->size);
+        if (m->mapping) CloseHandle(m->mapping);
+        CloseHandle(m->file);
+        memset(m, 0, sizeof(*m));
+        return 0;
+    }
+    (void)prefetch;
+#else
+    m->fd = open(path, O_RDONLY);
+    struct stat st;
+    if (m->fd < 0 || fstat(m->fd, &st) != 0) {
+        SDL_Log("Não foi possível abrir %s", path);
+        if (m->fd >= 0) close(m->fd);
+        memset(m, 0, sizeof(*m));
+        return 0;
+    }
+    m->size = (size_t)st.st_size;
+    void* p = m->size >= min_size && m->size > 0 ? mmap(NULL, m->size, PROT_READ, MAP_PRIVATE, m->fd, 0) : MAP_FAILED;
+    if (p == MAP_FAILED) {
+        SDL_Log("Falha ao mapear %s (%zu bytes)", path, m->size);
+        close(m->fd);
+        memset(m, 0, sizeof(*m));
         return 0;
     }
+    // leitura em geral sequencial; o começo é pedido já
+    madvise(p, m->size, MADV_SEQUENTIAL);
+    madvise(p, m->size < prefetch ? m->size : prefetch, MADV_WILLNEED);
+    m->data = (const Uint8*)p;
+#endif
+    return 1;
+}
+
+typedef struct {
+    char path[1024];
+    MappedFile map;
+    const Uint8* data;                  // = map.data (NULL = sem cartucho)
+    size_t size;
+    // cabeçalho (lazy)
+    int header_parsed;
+    int header_ok;                      // CRC16 do cabeçalho confere
+    char game_title[13];
+    char game_code[5];
+    char maker_code[3];
+    Uint32 rom_used;                    // bytes usados declarados no cabeçalho
+    // banner (lazy)
+    int banner_parsed;
+    int banner_ok;
+    char banner_title[128];             // título em inglês, UTF-8, linhas separadas por " / "
+    Uint32 icon[32 * 32];               // ARGB8888
+    SDL_Texture* icon_tex;
+} Cartridge;
+
+static Cartridge cart = {0};
+static unsigned cart_generation = 0;   // muda a cada inserir/ejetar (conteúdo do modal Info)
+
+static Uint32 cart_read_u32(const Uint8* p) { return (Uint32)p[0] | (Uint32)p[1] << 8 | (Uint32)p[2] << 16 | (Uint32)p[3] << 24; }
+static Uint16 cart_read_u16(const Uint8* p) { return (Uint16)(p[0] | p[1] << 8); }
+
+// CRC-16/MODBUS (o do cabeçalho e do banner do DS)
+static Uint16 cart_crc16(const Uint8* p, size_t n) {
+    Uint16 crc = 0xFFFF;
+    for (size_t i = 0; i < n; ++i) {
+        crc ^= p[i];
+        for (int b = 0; b < 8; ++b) crc = (crc & 1) ? (Uint16)((crc >> 1) ^ 0xA001) : (Uint16)(crc >> 1);
+    }
+    return crc;
+}
+
+// desfaz o mapeamento sem log (também usado pelo scan da biblioteca)
+static void cart_unmap(Cartridge* c) {
+    if (c->icon_tex) SDL_DestroyTexture(c->icon_tex);
+    file_unmap(&c->map);
+    memset(c, 0, sizeof(*c));
+}
+
+// mapeia 'path' só leitura em 'c' (vazio); 0 = falhou (com log)
+static int cart_map(Cartridge* c, const char* path) {
+    memset(c, 0, sizeof(*c));
+    // cabeçalho, banner e área de boot já; o resto da ROM sob demanda
+    if (!file_map(&c->map, path, CART_HEADER_SIZE, CART_PREFETCH)) return 0;
+    snprintf(c->path, sizeof(c->path), "%s", path);
+    c->data = c->map.data;
+    c->size = c->map.size;
+    return 1;
+}
+
+static void cart_eject(Cartridge* c) {
+    if (c->data) {
+        SDL_Log("Cartucho ejetado: %s", c->path);
+        cart_generation++;
+    }
+    cart_unmap(c);
+}
+
+// mapeia 'path'; o cartucho anterior é ejetado antes. Retorna 0 (com log) se falhar.
+static int cart_insert(Cartridge* c, const char* path) {
+    cart_eject(c);
+    if (!cart_map(c, path)) return 0;
+    cart_generation++;
+    SDL_Log("Cartucho inserido: %s (%.1f MB mapeados)", path, (double)c->size / (1024.0 * 1024.0));
+    return 1;
+}
+
+static void cart_copy_ascii(char* dst, const Uint8* src, int n) {
+    for (int i = 0; i < n; ++i) dst[i] = (src[i] >= 0x20 && src[i] < 0x7F) ? (char)src[i] : '\0';
+    dst[n] = '\0';
+}
+
+// cabeçalho: só na primeira consulta
+static int cart_header(Cartridge* c) {
+    if (!c->data) return 0;
+    if (c->header_parsed) return c->header_ok;
+    const Uint8* h = c->data;
+    c->header_parsed = 1;
+    cart_copy_ascii(c->game_title, h + 0x00, 12);
+    cart_copy_ascii(c->game_code, h + 0x0C, 4);
+    cart_copy_ascii(c->maker_code, h + 0x10, 2);
+    c->rom_used = cart_read_u32(h + 0x80);
+    c->header_ok = cart_crc16(h, 0x15E) == cart_read_u16(h + 0x15E);
+    if (!c->header_ok) SDL_Log("Cartucho: CRC do cabeçalho não confere (%s)", c->path);
+    return c->header_ok;
+}
+
+// banner (ícone 32x32 4bpp em tiles 8x8 + paleta BGR555 + título UTF-16): só quando pedido
+static int cart_banner(Cartridge* c) {
+    if (!c->data) return 0;
+    if (c->banner_parsed) return c->banner_ok;
+    c->banner_parsed = 1;
+    Uint32 off = cart_read_u32(c->data + 0x68);
+    if (off == 0 || (size_t)off + CART_BANNER_SIZE > c->size) return 0;
+    const Uint8* b = c->data + off;
+
+    Uint32 pal[16];
+    for (int i = 0; i < 16; ++i) {
+        Uint16 v = cart_read_u16(b + 0x220 + 2 * i);
+        Uint32 r = (v & 31u) * 255 / 31, g = ((v >> 5) & 31u) * 255 / 31, bl = ((v >> 10) & 31u) * 255 / 31;
+        pal[i] = (i == 0 ? 0u : 0xFF000000u) | r << 16 | g << 8 | bl; // cor 0 é transparente
+    }
+    for (int t = 0; t < 16; ++t) {
+        const Uint8* tile = b + 0x20 + 32 * t;
+        int tx = (t & 3) * 8, ty = (t >> 2) * 8;
+        for (int i = 0; i < 64; ++i) {
+            int nib = (tile[i >> 1] >> ((i & 1) * 4)) & 15;
+            c->icon[(ty + (i >> 3)) * 32 + tx + (i & 7)] = pal[nib];
+        }
+    }
 
+    // título em inglês (segunda entrada de 256 bytes), UTF-16LE -> UTF-8
+    const Uint8* u = b + 0x240 + 0x100;
+    size_t o = 0;
+    for (int i = 0; i < 128 && o + 4 < sizeof(c->banner_title); ++i) {
+        Uint16 ch = cart_read_u16(u + 2 * i);
+        if (ch == 0) break;
+        if (ch == '\n') { if (o + 4 < sizeof(c->banner_title)) { memcpy(c->banner_title + o, " / ", 3); o += 3; } continue; }
+        if (ch < 0x80) c->banner_title[o++] = (char)ch;
+        else if (ch < 0x800) { c->banner_title[o++] = (char)(0xC0 | ch >> 6); c->banner_title[o++] = (char)(0x80 | (ch & 0x3F)); }
+        else if (ch < 0xD800 || ch > 0xDFFF) {
+            c->banner_title[o++] = (char)(0xE0 | ch >> 12);
+            c->banner_title[o++] = (char)(0x80 | ((ch >> 6) & 0x3F));
+            c->banner_title[o++] = (char)(0x80 | (ch & 0x3F));
+        }
+    }
+    c->banner_title[o] = '\0';
+    c->banner_ok = 1;
     return 1;
 }
 
+// textura do ícone, criada na primeira vez que o modal Info a desenha
+static SDL_Texture* cart_icon_texture(Cartridge* c, SDL_Renderer* renderer) {
+    if (c->icon_tex || !cart_banner(c)) return c->icon_tex;
+    c->icon_tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, 32, 32);
+    if (!c->icon_tex) { SDL_Log("CreateTexture failed: %s", SDL_GetError()); return NULL; }
+    SDL_UpdateTexture(c->icon_tex, NULL, c->icon, 32 * (int)sizeof(Uint32));
+    SDL_SetTextureBlendMode(c->icon_tex, SDL_BLENDMODE_BLEND);
+    return c->icon_tex;
+}
+
 // computeMenuBoxes: windowed uses fixed spacing; fullscreen uses responsive.
 // Both modes reserve space at right for volume indicator and clamp menus to available area.
-void computeMenuBoxes(TTF_Font* font, int is_fullscreen) {
+void computeMenuBoxes(GlyphAtlas* atlas, int is_fullscreen) {
     int margin_left = 10;
     int margin_right = 12;
     int right_reserved = RIGHT_RESERVED;
@@ -206,9 +1102,8 @@ void computeMenuBoxes(TTF_Font* font, int is_fullscreen) {
         int x = margin_left;
         for (int i = 0; i < numMenus; ++i) {
             int w = 0, h = 0;
-            if (TTF_SizeUTF8(font, menus[i], &w, &h) != 0) {
-                w = 50; // fallback
-            }
+            measureText(atlas, menus[i], &w, &h);
+            if (w <= 0) w = 50; // fallback
             int boxw = w + MENU_PADDING;
             if (x + boxw > available_width) {
                 boxw = available_width - x;
@@ -227,7 +1122,8 @@ void computeMenuBoxes(TTF_Font* font, int is_fullscreen) {
     int textWidths[numMenus];
     int textH;
     for (int i = 0; i < numMenus; ++i) {
-        if (TTF_SizeUTF8(font, menus[i], &textWidths[i], &textH) != 0) textWidths[i] = 50;
+        measureText(atlas, menus[i], &textWidths[i], &textH);
+        if (textWidths[i] <= 0) textWidths[i] = 50;
         totalTextW += textWidths[i];
     }
 
@@ -253,7 +1149,7 @@ void computeMenuBoxes(TTF_Font* font, int is_fullscreen) {
     }
 }
 
-void drawMenuBar(SDL_Renderer* renderer, TTF_Font* font) {
+void drawMenuBar(SDL_Renderer* renderer, GlyphAtlas* atlas) {
     SDL_Rect menuBar = {0, 0, win_w, MENU_HEIGHT};
     // THEME: use currentTheme.menuBg for menu background
     SDL_SetRenderDrawColor(renderer,
@@ -284,27 +1180,13 @@ void drawMenuBar(SDL_Renderer* renderer, TTF_Font* font) {
             SDL_RenderFillRect(renderer, &r);
         }
 
-        SDL_Surface* surface = TTF_RenderUTF8_Solid(font, menus[i], textColor);
-        if (!surface) {
-            SDL_Log("TTF_RenderUTF8_Solid failed: %s", TTF_GetError());
-            continue;
-        }
-        SDL_Texture* textureText = SDL_CreateTextureFromSurface(renderer, surface);
-        if (!textureText) {
-            SDL_Log("CreateTextureFromSurface failed: %s", SDL_GetError());
-            SDL_FreeSurface(surface);
-            continue;
-        }
-        int textY = y + (h - surface->h) / 2;
-        SDL_Rect dst = {x + 8, textY, surface->w, surface->h};
-        SDL_RenderCopy(renderer, textureText, NULL, &dst);
-        SDL_FreeSurface(surface);
-        SDL_DestroyTexture(textureText);
+        int textY = y + (h - atlas->height) / 2;
+        drawText(renderer, atlas, menus[i], x + 8, textY, textColor);
     }
 }
 
 // drawDropdown: adjusts x so dropdown never draws off-screen; clamps left/right.
-void drawDropdown(SDL_Renderer* renderer, TTF_Font* font, const char* items[], int numItems, int x, int y, int width) {
+void drawDropdown(SDL_Renderer* renderer, GlyphAtlas* atlas, const char* items[], int numItems, int x, int y, int width) {
     if (!items || numItems <= 0) return;
     SDL_Color textColorNormal = { fcol_to_u8(currentTheme.text.r), fcol_to_u8(currentTheme.text.g), fcol_to_u8(currentTheme.text.b), fcol_to_u8(currentTheme.text.a) };
     SDL_Color textColorHover = { fcol_to_u8(currentTheme.panel.r), fcol_to_u8(currentTheme.panel.g), fcol_to_u8(currentTheme.panel.b), fcol_to_u8(currentTheme.panel.a) };
@@ -332,44 +1214,27 @@ void drawDropdown(SDL_Renderer* renderer, TTF_Font* font, const char* items[], i
         SDL_RenderFillRect(renderer, &rect);
 
         SDL_Color textColor = isHover ? textColorHover : textColorNormal;
-        SDL_Surface* surface = TTF_RenderUTF8_Solid(font, items[i], textColor);
-        if (!surface) {
-            SDL_Log("TTF_RenderUTF8_Solid failed for dropdown item: %s", TTF_GetError());
-            continue;
-        }
-        SDL_Texture* textureText = SDL_CreateTextureFromSurface(renderer, surface);
-        if (!textureText) {
-            SDL_Log("CreateTextureFromSurface failed: %s", SDL_GetError());
-            SDL_FreeSurface(surface);
-            continue;
-        }
-        SDL_Rect dst = {x + 8, y + 4 + i * itemHeight, surface->w, surface->h};
-        SDL_RenderCopy(renderer, textureText, NULL, &dst);
-        SDL_FreeSurface(surface);
-        SDL_DestroyTexture(textureText);
+        drawText(renderer, atlas, items[i], x + 8, y + 4 + i * itemHeight, textColor);
     }
 }
 
-void drawThemeSelection(SDL_Renderer* renderer, TTF_Font* font, Modal* m) {
-    // botões: dois botões lado a lado dentro do modal
+// botões de opção lado a lado dentro do modal (Tema, Resolução); row = linha de botões
+static SDL_Rect modalOptionButtonRect(const Modal* m, int row, int count, int i) {
     int padding = 12;
-    int btnW = (m->rect.w - padding*3) / 2;
+    int btnW = (m->rect.w - padding * (count + 1)) / count;
     int btnH = 36;
-    int bx = m->rect.x + padding;
-    int by = m->rect.y + 48;
-
-    // texto e cores
-    SDL_Color textColor = { fcol_to_u8(currentTheme.text.r), fcol_to_u8(currentTheme.text.g), fcol_to_u8(currentTheme.text.b), fcol_to_u8(currentTheme.text.a) };
-    SDL_Color btnTextColor = textColor;
+    SDL_Rect btn = { m->rect.x + padding + i * (btnW + padding), m->rect.y + 48 + row * (btnH + padding), btnW, btnH };
+    return btn;
+}
 
-    for (int i = 0; i < themeOptionsCount; ++i) {
-        SDL_Rect btn = { bx + i * (btnW + padding), by, btnW, btnH };
-        // destaque do botão atualmente selecionado (com base no targetTheme.name)
-        int isSelected = 0;
-        if (strcmp(themeOptions[i], "Escuro") == 0 && strcmp(targetTheme.name, "Dark Default") == 0) isSelected = 1;
-        if (strcmp(themeOptions[i], "Claro") == 0 && strcmp(targetTheme.name, "Light Soft") == 0) isSelected = 1;
+static void drawModalOptionButtons(SDL_Renderer* renderer, GlyphAtlas* atlas, const Modal* m, int row,
+                                   const char* options[], int count, int selected) {
+    SDL_Color btnTextColor = { fcol_to_u8(currentTheme.text.r), fcol_to_u8(currentTheme.text.g), fcol_to_u8(currentTheme.text.b), fcol_to_u8(currentTheme.text.a) };
 
-        if (isSelected) {
+    for (int i = 0; i < count; ++i) {
+        SDL_Rect btn = modalOptionButtonRect(m, row, count, i);
+        // destaque do botão atualmente selecionado
+        if (i == selected) {
             SDL_SetRenderDrawColor(renderer,
                                    fcol_to_u8(currentTheme.accent.r),
                                    fcol_to_u8(currentTheme.accent.g),
@@ -385,20 +1250,91 @@ void drawThemeSelection(SDL_Renderer* renderer, TTF_Font* font, Modal* m) {
         SDL_RenderFillRect(renderer, &btn);
 
         // texto do botão
-        SDL_Surface* s = TTF_RenderUTF8_Solid(font, themeOptions[i], btnTextColor);
-        if (s) {
-            SDL_Texture* t = SDL_CreateTextureFromSurface(renderer, s);
-            if (t) {
-                SDL_Rect dst = { btn.x + (btn.w - s->w)/2, btn.y + (btn.h - s->h)/2, s->w, s->h };
-                SDL_RenderCopy(renderer, t, NULL, &dst);
-                SDL_DestroyTexture(t);
-            }
-            SDL_FreeSurface(s);
-        }
+        int tw = 0, th = 0;
+        measureText(atlas, options[i], &tw, &th);
+        drawText(renderer, atlas, options[i], btn.x + (btn.w - tw)/2, btn.y + (btn.h - th)/2, btnTextColor);
+    }
+}
+
+// linhas de botões de opção de cada tipo de modal
+typedef struct {
+    const char** options;
+    int count;
+    int selected;
+} ModalRow;
+
+#define MODAL_MAX_ROWS 3
+
+static int modalRows(ModalKind kind, ModalRow rows[MODAL_MAX_ROWS]) {
+    switch (kind) {
+    case MODAL_THEME: {
+        // botão selecionado com base no targetTheme.name
+        int selected = -1;
+        if (strcmp(targetTheme.name, "Dark Default") == 0) selected = 0;
+        if (strcmp(targetTheme.name, "Light Soft") == 0) selected = 1;
+        rows[0] = (ModalRow){ themeOptions, themeOptionsCount, selected };
+        return 1;
+    }
+    case MODAL_RESOLUTION:
+        // linha 0: escala fixa (em Auto mostra a escala escolhida pelo controlador); linha 1: modo
+        rows[0] = (ModalRow){ bgScaleOptions, bgScaleOptionsCount, bgScaleIndex };
+        rows[1] = (ModalRow){ dynResOptions, dynResOptionsCount, dynResIndex };
+        return 2;
+    case MODAL_VIDEO:
+        rows[0] = (ModalRow){ renderModeOptions, renderModeOptionsCount, renderModeIndex };
+        rows[1] = (ModalRow){ vsyncOptions, vsyncOptionsCount, vsyncIndex };
+        rows[2] = (ModalRow){ bgBakeOptions, bgBakeOptionsCount, bgBakeIndex };
+        return 3;
+    case MODAL_REWIND:
+        rows[0] = (ModalRow){ rewindOptions, rewindOptionsCount, rewindIndex };
+        return 1;
+    case MODAL_CONTROLS:
+        rows[0] = (ModalRow){ runAheadOptions, runAheadOptionsCount, runAheadIndex };
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// biblioteca de cartuchos (definida depois do worker pool)
+static void drawLibrary(SDL_Renderer* renderer, GlyphAtlas* atlas, const Modal* m, SDL_Color textColor);
+static int library_find_hashes(const char* path, Uint32* crc, Uint8 sha1[20]);
+// Sistema -> Rebobinar (definido depois dos save states)
+static void drawRewindInfo(SDL_Renderer* renderer, GlyphAtlas* atlas, const Modal* m, SDL_Color textColor);
+
+// Cartucho -> Info: ícone (2x) e campos do cabeçalho/banner, lidos só agora
+static void drawCartInfo(SDL_Renderer* renderer, GlyphAtlas* atlas, const Modal* m, SDL_Color textColor) {
+    int x = m->rect.x + 12, y = m->rect.y + 40;
+    if (!cart.data) {
+        drawText(renderer, atlas, "Nenhum cartucho inserido", x, y, textColor);
+        return;
+    }
+    SDL_Texture* icon = cart_icon_texture(&cart, renderer);
+    if (icon) {
+        SDL_Rect dst = { x, y, 64, 64 };
+        SDL_RenderCopy(renderer, icon, NULL, &dst);
+        x += 64 + 12;
+    }
+    int line_h = atlas->height > 0 ? atlas->height + 2 : 20;
+    char buf[256];
+    cart_header(&cart);
+    if (cart.banner_ok && cart.banner_title[0]) { drawText(renderer, atlas, cart.banner_title, x, y, textColor); y += line_h; }
+    snprintf(buf, sizeof(buf), "%s  [%s-%s]%s", cart.game_title, cart.game_code, cart.maker_code,
+             cart.header_ok ? "" : "  (cabeçalho inválido)");
+    drawText(renderer, atlas, buf, x, y, textColor); y += line_h;
+    snprintf(buf, sizeof(buf), "%.1f MB (%.1f MB usados)", (double)cart.size / (1024.0 * 1024.0), (double)cart.rom_used / (1024.0 * 1024.0));
+    drawText(renderer, atlas, buf, x, y, textColor); y += line_h;
+    // hashes só se a biblioteca já os tem (nunca hashear a ROM aqui)
+    Uint32 crc;
+    Uint8 sha1[20];
+    if (library_find_hashes(cart.path, &crc, sha1)) {
+        int o = snprintf(buf, sizeof(buf), "CRC32 %08X  SHA-1 ", crc);
+        for (int i = 0; i < 20; ++i) o += snprintf(buf + o, sizeof(buf) - (size_t)o, "%02x", sha1[i]);
+        drawText(renderer, atlas, buf, x, y, textColor);
     }
 }
 
-void drawModal(SDL_Renderer* renderer, TTF_Font* font, Modal* m) {
+void drawModal(SDL_Renderer* renderer, GlyphAtlas* atlas, Modal* m) {
     if (!m->open) return;
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
     SDL_SetRenderDrawColor(renderer, 0,0,0,120);
@@ -420,42 +1356,26 @@ void drawModal(SDL_Renderer* renderer, TTF_Font* font, Modal* m) {
     SDL_RenderDrawRect(renderer, &m->rect);
 
     SDL_Color textColor = { fcol_to_u8(currentTheme.text.r), fcol_to_u8(currentTheme.text.g), fcol_to_u8(currentTheme.text.b), fcol_to_u8(currentTheme.text.a) };
-    SDL_Surface* sTitle = TTF_RenderUTF8_Solid(font, m->title, textColor);
-    if (sTitle) {
-        SDL_Texture* tTitle = SDL_CreateTextureFromSurface(renderer, sTitle);
-        if (tTitle) {
-            int titleY = m->rect.y + 8;
-            SDL_Rect dstTitle = {m->rect.x + 12, titleY, sTitle->w, sTitle->h};
-            SDL_RenderCopy(renderer, tTitle, NULL, &dstTitle);
-            SDL_DestroyTexture(tTitle);
-        } else {
-            SDL_Log("CreateTextureFromSurface failed for modal title: %s", SDL_GetError());
-        }
-        SDL_FreeSurface(sTitle);
-    } else {
-        SDL_Log("TTF_RenderUTF8_Solid failed for modal title: %s", TTF_GetError());
-    }
-
-    // se for modal de tema, desenhar opções
-    if (strcmp(m->title, "Tema") == 0) {
-        drawThemeSelection(renderer, font, m);
-        // draw close button after content
-        SDL_SetRenderDrawColor(renderer,
-                               fcol_to_u8(currentTheme.accent.r),
-                               fcol_to_u8(currentTheme.accent.g),
-                               fcol_to_u8(currentTheme.accent.b),
-                               fcol_to_u8(currentTheme.accent.a));
-        SDL_RenderFillRect(renderer, &m->closeBtn);
-        SDL_SetRenderDrawColor(renderer, 255,255,255,255);
-        int cx = m->closeBtn.x + 4;
-        int cy = m->closeBtn.y + 4;
-        int cw = m->closeBtn.w - 8;
-        int ch = m->closeBtn.h - 8;
-        SDL_RenderDrawLine(renderer, cx, cy, cx + cw, cy + ch);
-        SDL_RenderDrawLine(renderer, cx + cw, cy, cx, cy + ch);
-        return; // não desenhar o placeholder padrão
+    drawText(renderer, atlas, m->title, m->rect.x + 12, m->rect.y + 8, textColor);
+
+    // conteúdo por tipo de modal
+    ModalRow rows[MODAL_MAX_ROWS];
+    int nrows = modalRows(m->kind, rows);
+    for (int r = 0; r < nrows; ++r)
+        drawModalOptionButtons(renderer, atlas, m, r, rows[r].options, rows[r].count, rows[r].selected);
+    if (m->kind == MODAL_CART_INFO) drawCartInfo(renderer, atlas, m, textColor);
+    else if (m->kind == MODAL_LIBRARY) drawLibrary(renderer, atlas, m, textColor);
+    else if (m->kind == MODAL_REWIND) drawRewindInfo(renderer, atlas, m, textColor);
+    else if (m->kind == MODAL_CONTROLS)
+        drawText(renderer, atlas, "Run-ahead: custo extra por quadro no HUD (F3)", m->rect.x + 12, m->rect.y + 100, textColor);
+    else if (m->kind == MODAL_CART_INSERT)
+        drawText(renderer, atlas, "Arraste um arquivo .nds para a janela", m->rect.x + 12, m->rect.y + 40, textColor);
+    else if (m->kind == MODAL_PLACEHOLDER) {
+        const char* placeholder = "Conteúdo da janela (substituir depois)";
+        drawText(renderer, atlas, placeholder, m->rect.x + 12, m->rect.y + 40, textColor);
     }
 
+    // draw close button after content
     SDL_SetRenderDrawColor(renderer,
                            fcol_to_u8(currentTheme.accent.r),
                            fcol_to_u8(currentTheme.accent.g),
@@ -463,36 +1383,39 @@ void drawModal(SDL_Renderer* renderer, TTF_Font* font, Modal* m) {
                            fcol_to_u8(currentTheme.accent.a));
     SDL_RenderFillRect(renderer, &m->closeBtn);
     SDL_SetRenderDrawColor(renderer, 255,255,255,255);
-    {
-        int cx = m->closeBtn.x + 4;
-        int cy = m->closeBtn.y + 4;
-        int cw = m->closeBtn.w - 8;
-        int ch = m->closeBtn.h - 8;
-        SDL_RenderDrawLine(renderer, cx, cy, cx + cw, cy + ch);
-        SDL_RenderDrawLine(renderer, cx + cw, cy, cx, cy + ch);
-    }
-
-    const char* placeholder = "Conteúdo da janela (substituir depois)";
-    SDL_Surface* sCont = TTF_RenderUTF8_Solid(font, placeholder, textColor);
-    if (sCont) {
-        SDL_Texture* tCont = SDL_CreateTextureFromSurface(renderer, sCont);
-        if (tCont) {
-            SDL_Rect dstCont = {m->rect.x + 12, m->rect.y + 40, sCont->w, sCont->h};
-            SDL_RenderCopy(renderer, tCont, NULL, &dstCont);
-            SDL_DestroyTexture(tCont);
-        }
-        SDL_FreeSurface(sCont);
-    }
+    int cx = m->closeBtn.x + 4;
+    int cy = m->closeBtn.y + 4;
+    int cw = m->closeBtn.w - 8;
+    int ch = m->closeBtn.h - 8;
+    SDL_RenderDrawLine(renderer, cx, cy, cx + cw, cy + ch);
+    SDL_RenderDrawLine(renderer, cx + cw, cy, cx, cy + ch);
 }
 
 void openModalWithTitle(Modal* m, const char* title) {
     m->open = 1;
     strncpy(m->title, title, sizeof(m->title)-1);
     m->title[sizeof(m->title)-1] = '\0';
+    static const struct { const char* title; ModalKind kind; } kinds[] = {
+        {"Tema", MODAL_THEME}, {"Resolução", MODAL_RESOLUTION}, {"Vídeo", MODAL_VIDEO},
+        {"Inserir Cartucho", MODAL_CART_INSERT}, {"Info", MODAL_CART_INFO}, {"Biblioteca", MODAL_LIBRARY},
+        {"Rebobinar", MODAL_REWIND}, {"Controles", MODAL_CONTROLS},
+    };
+    m->kind = MODAL_PLACEHOLDER;
+    for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); ++i)
+        if (strcmp(m->title, kinds[i].title) == 0) m->kind = kinds[i].kind;
     int w = win_w * 60 / 100;
     int h = win_h * 35 / 100;
     if (w < 320) w = 320;
     if (h < 160) h = 160;
+    // Vídeo tem 3 linhas de botões (48 + 3 * (36 + 12)); Rebobinar/Controles têm 1 linha + texto
+    if ((m->kind == MODAL_VIDEO || m->kind == MODAL_REWIND || m->kind == MODAL_CONTROLS) && h < 192) h = 192;
+    // Biblioteca: lista com rolagem, quase a janela toda
+    if (m->kind == MODAL_LIBRARY) {
+        w = win_w * 80 / 100;
+        h = win_h * 75 / 100;
+        if (w < 320) w = 320;
+        if (h < 160) h = 160;
+    }
     m->rect.x = (win_w - w) / 2;
     m->rect.y = (win_h - h) / 2;
     m->rect.w = w; m->rect.h = h;
@@ -516,27 +1439,122 @@ void toggleFullscreen(SDL_Window* window) {
     }
 }
 
-void drawVolumeIndicator(SDL_Renderer* renderer, TTF_Font* font) {
+void drawVolumeIndicator(SDL_Renderer* renderer, GlyphAtlas* atlas) {
     char buf[64];
     if (muted) snprintf(buf, sizeof(buf), "Muted");
     else snprintf(buf, sizeof(buf), "Vol: %d%%", currentVolume);
     SDL_Color textColor = { fcol_to_u8(currentTheme.text.r), fcol_to_u8(currentTheme.text.g), fcol_to_u8(currentTheme.text.b), fcol_to_u8(currentTheme.text.a) };
-    SDL_Surface* s = TTF_RenderUTF8_Solid(font, buf, textColor);
-    if (!s) {
-        SDL_Log("TTF_RenderUTF8_Solid failed for volume indicator: %s", TTF_GetError());
-        return;
+    int tw = 0;
+    measureText(atlas, buf, &tw, NULL);
+    int right_margin = 12;
+    drawText(renderer, atlas, buf, win_w - tw - right_margin, 6, textColor);
+}
+
+// -------------------- perf HUD (F3) --------------------
+// Painel abaixo do indicador de volume: fps, gráfico dos últimos HUD_HISTORY intervalos
+// entre presents, tempos do sweep e da UI, texturas vivas e rasterizações de texto.
+// O texto sai direto do glyph atlas (drawTextGlyphs), sem tocar no cache de strings,
+// para o HUD não mudar os números que mostra.
+
+#define HUD_HISTORY 240
+#define HUD_GRAPH_H 60
+#define HUD_GRAPH_MAX_MS 33.3f // topo do gráfico
+
+typedef struct {
+    int visible;
+    float frame_ms[HUD_HISTORY]; // ring: intervalo entre presents
+    int head;
+    int count;
+    Uint64 last_present;
+    float sweep_ms;     // primeira faixa -> última faixa (parede)
+    float sweep_cpu_ms; // soma das faixas em todas as threads
+    float ui_ms;        // draw* da UI no main thread
+    int rasters;        // TTF_Render* no último frame
+    int rewind_on;      // Sistema -> Rebobinar ligado
+    float rewind_seconds;
+    float rewind_mb;
+    float rewind_capture_us; // cópia do snapshot no main thread
+    int runahead_frames;     // Controles -> run-ahead
+    float runahead_us;       // capture + passos adiantados + restore
+} PerfHud;
+
+static PerfHud perfHud;
+
+static void perf_hud_present(PerfHud* h, Uint64 now, double perf_ms) {
+    if (h->last_present) {
+        h->frame_ms[h->head] = (float)((now - h->last_present) * perf_ms);
+        h->head = (h->head + 1) % HUD_HISTORY;
+        if (h->count < HUD_HISTORY) h->count++;
     }
-    SDL_Texture* t = SDL_CreateTextureFromSurface(renderer, s);
-    if (!t) {
-        SDL_Log("CreateTextureFromSurface failed for volume indicator: %s", SDL_GetError());
-        SDL_FreeSurface(s);
-        return;
+    h->last_present = now;
+}
+
+static int hud_texture_count(void) {
+    int n = uiTextCache.count + (uiAtlas.texture ? 1 : 0);
+    for (int i = 0; i < BG_TEXTURE_COUNT; ++i) n += bgTextures[i] ? 1 : 0;
+    return n;
+}
+
+static void drawPerfHud(SDL_Renderer* renderer, GlyphAtlas* atlas, const PerfHud* h) {
+    if (!h->visible) return;
+    const int pad = 8;
+    const int line_h = atlas->height > 0 ? atlas->height : 18;
+    const int box_w = HUD_HISTORY + 2 * pad;
+    const int lines = 4 + (h->rewind_on ? 1 : 0) + (h->runahead_frames > 0 ? 1 : 0);
+    const int box_h = lines * line_h + HUD_GRAPH_H + 3 * pad;
+    SDL_Rect box = { win_w - box_w - 12, MENU_HEIGHT + 8, box_w, box_h };
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 170);
+    SDL_RenderFillRect(renderer, &box);
+
+    // fps pela média dos últimos 60 intervalos
+    float avg = 0.0f;
+    int n = h->count < 60 ? h->count : 60;
+    for (int i = 0; i < n; ++i) avg += h->frame_ms[(h->head + HUD_HISTORY - 1 - i) % HUD_HISTORY];
+    avg = n > 0 ? avg / (float)n : 0.0f;
+
+    char buf[96];
+    SDL_Color c = { 230, 236, 242, 255 };
+    int x = box.x + pad, y = box.y + pad;
+    snprintf(buf, sizeof(buf), "%.1f fps  %.2f ms", avg > 0.0f ? 1000.0f / avg : 0.0f, avg);
+    drawTextGlyphs(renderer, atlas, buf, x, y, c); y += line_h;
+    snprintf(buf, sizeof(buf), "sweep %.2f ms  cpu %.2f ms", h->sweep_ms, h->sweep_cpu_ms);
+    drawTextGlyphs(renderer, atlas, buf, x, y, c); y += line_h;
+    snprintf(buf, sizeof(buf), "ui %.2f ms", h->ui_ms);
+    drawTextGlyphs(renderer, atlas, buf, x, y, c); y += line_h;
+    snprintf(buf, sizeof(buf), "texturas %d  rasters %d", hud_texture_count(), h->rasters);
+    drawTextGlyphs(renderer, atlas, buf, x, y, c); y += line_h;
+    if (h->rewind_on) {
+        snprintf(buf, sizeof(buf), "rewind %.0f s  %.1f MB  %.1f us", h->rewind_seconds, h->rewind_mb, h->rewind_capture_us);
+        drawTextGlyphs(renderer, atlas, buf, x, y, c); y += line_h;
     }
-    int right_margin = 12;
-    SDL_Rect dst = {win_w - s->w - right_margin, 6, s->w, s->h};
-    SDL_RenderCopy(renderer, t, NULL, &dst);
-    SDL_FreeSurface(s);
-    SDL_DestroyTexture(t);
+    if (h->runahead_frames > 0) {
+        snprintf(buf, sizeof(buf), "run-ahead %d  +%.1f us", h->runahead_frames, h->runahead_us);
+        drawTextGlyphs(renderer, atlas, buf, x, y, c); y += line_h;
+    }
+    y += pad;
+
+    // gráfico: uma barra de 1 px por frame, mais antigo à esquerda; linha em 16.7 ms
+    SDL_Rect bars[HUD_HISTORY];
+    int nb = 0;
+    int base = y + HUD_GRAPH_H;
+    for (int i = 0; i < h->count; ++i) {
+        float ms = h->frame_ms[(h->head + HUD_HISTORY - h->count + i) % HUD_HISTORY];
+        int bh = (int)(ms / HUD_GRAPH_MAX_MS * HUD_GRAPH_H);
+        if (bh < 1) bh = 1;
+        if (bh > HUD_GRAPH_H) bh = HUD_GRAPH_H;
+        bars[nb++] = (SDL_Rect){ x + HUD_HISTORY - h->count + i, base - bh, 1, bh };
+    }
+    SDL_SetRenderDrawColor(renderer,
+                           fcol_to_u8(currentTheme.accent.r),
+                           fcol_to_u8(currentTheme.accent.g),
+                           fcol_to_u8(currentTheme.accent.b), 255);
+    if (nb > 0) SDL_RenderFillRects(renderer, bars, nb);
+    int y60 = base - (int)(16.7f / HUD_GRAPH_MAX_MS * HUD_GRAPH_H);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 90);
+    SDL_RenderDrawLine(renderer, x, y60, x + HUD_HISTORY - 1, y60);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
 }
 
 // -------------------- Smooth color animation (peak-synced) --------------------
@@ -549,6 +1567,8 @@ typedef struct {
     // elapsed time and duration
     float t;
     float duration;
+    // RNG privado (xorshift32): copiar o ColorAnim copia o futuro dele (bake de keyframes)
+    Uint32 rng;
 } ColorAnim;
 
 #define NUM_COLOR_ANIMS 3
@@ -564,12 +1584,19 @@ static inline float smoothstep_f(float t) {
     return t * t * (3.0f - 2.0f * t);
 }
 
+static float anim_rand01(ColorAnim* ca) {
+    Uint32 x = ca->rng;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    ca->rng = x;
+    return (float)(x >> 8) * (1.0f / 16777215.0f);
+}
+
 // pick a new random target color in a pleasant range
 static void pick_new_target(ColorAnim* ca) {
     // choose target in [0.15, 1.0] to avoid too dark
-    ca->tr = 0.15f + ((float)rand() / (float)RAND_MAX) * 0.85f;
-    ca->tg = 0.15f + ((float)rand() / (float)RAND_MAX) * 0.85f;
-    ca->tb = 0.15f + ((float)rand() / (float)RAND_MAX) * 0.85f;
+    ca->tr = 0.15f + anim_rand01(ca) * 0.85f;
+    ca->tg = 0.15f + anim_rand01(ca) * 0.85f;
+    ca->tb = 0.15f + anim_rand01(ca) * 0.85f;
     // reset elapsed time (start of new transition)
     ca->t = 0.0f;
 }
@@ -580,14 +1607,15 @@ static void init_color_anims(float duration_seconds) {
         // start from a mid tone
         colorAnims[i].sr = colorAnims[i].sg = colorAnims[i].sb = 0.5f;
         colorAnims[i].duration = duration_seconds;
+        colorAnims[i].rng = (Uint32)rand() | 1u; // semente vem do srand()
         pick_new_target(&colorAnims[i]);
     }
 }
 
 // update animations by delta seconds; speedMultiplier >1.0 accelerates transitions (used on peaks)
-static void update_color_anims(float delta, float speedMultiplier) {
+static void step_color_anims(ColorAnim* anims, float delta, float speedMultiplier) {
     for (int i = 0; i < NUM_COLOR_ANIMS; ++i) {
-        ColorAnim* ca = &colorAnims[i];
+        ColorAnim* ca = &anims[i];
         // advance time scaled by multiplier (faster during peaks)
         ca->t += delta * speedMultiplier;
 
@@ -606,6 +1634,10 @@ static void update_color_anims(float delta, float speedMultiplier) {
     }
 }
 
+static void update_color_anims(float delta, float speedMultiplier) {
+    step_color_anims(colorAnims, delta, speedMultiplier);
+}
+
 // get current interpolated color into out[3] (r,g,b) using smoothstep easing
 static void get_anim_color(const ColorAnim* ca, float out[3]) {
     float tt = ca->t / ca->duration;
@@ -619,62 +1651,3535 @@ static void get_anim_color(const ColorAnim* ca, float out[3]) {
 
 // -------------------- end color animation --------------------
 
+// -------------------- simulation clock --------------------
+// Animações (e futuramente a emulação) andam em passos fixos de SIM_DT, independentes
+// do fps: o acumulador recebe o tempo real do contador de alta resolução e é consumido
+// em passos inteiros. O render interpola entre o estado antes e depois do último passo
+// com alpha = resto do acumulador / SIM_DT.
+
+#define SIM_HZ 120
+#define SIM_DT (1.0 / SIM_HZ)
+#define SIM_MAX_STEPS 12 // ~0.1 s por frame; o excesso é descartado (janela parada, debugger)
+
+typedef struct {
+    Uint64 freq;
+    Uint64 last;
+    double accumulator; // segundos ainda não simulados
+    Uint64 ticks;       // passos executados desde o início
+} SimClock;
+
+static ColorAnim colorAnimsPrev[NUM_COLOR_ANIMS]; // estado antes do último passo
+static unsigned sim_timeline = 0; // muda a cada salto no tempo (estado carregado, rewind)
+
+static void sim_clock_init(SimClock* sc) {
+    sc->freq = SDL_GetPerformanceFrequency();
+    sc->last = SDL_GetPerformanceCounter();
+    sc->accumulator = 0.0;
+    sc->ticks = 0;
+    memcpy(colorAnimsPrev, colorAnims, sizeof(colorAnims));
+}
+
+// quantos passos de SIM_DT rodar neste frame
+static int sim_clock_advance(SimClock* sc) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    sc->accumulator += (double)(now - sc->last) / (double)sc->freq;
+    sc->last = now;
+    int steps = (int)(sc->accumulator / SIM_DT);
+    if (steps > SIM_MAX_STEPS) {
+        sc->accumulator = fmod(sc->accumulator, SIM_DT) + SIM_MAX_STEPS * SIM_DT;
+        steps = SIM_MAX_STEPS;
+    }
+    sc->accumulator -= steps * SIM_DT;
+    sc->ticks += (Uint64)steps;
+    return steps;
+}
+
+static float sim_clock_alpha(const SimClock* sc) {
+    float a = (float)(sc->accumulator / SIM_DT);
+    return a < 0.0f ? 0.0f : (a > 1.0f ? 1.0f : a);
+}
+
+// um passo fixo: transição de tema + color anims
+static void sim_step(float dt) {
+    memcpy(colorAnimsPrev, colorAnims, sizeof(colorAnims));
+    theme_t_prev = theme_t;
+    if (theme_t < 1.0f) {
+        theme_t += dt / (theme_duration > 0.0f ? theme_duration : 0.45f);
+        if (theme_t > 1.0f) theme_t = 1.0f;
+    }
+    update_color_anims(dt, 1.0f);
+}
+
+// cor da anim i interpolada entre os dois últimos passos
+static void sim_anim_color(int i, float alpha, float out[3]) {
+    float a[3], b[3];
+    get_anim_color(&colorAnimsPrev[i], a);
+    get_anim_color(&colorAnims[i], b);
+    for (int c = 0; c < 3; ++c) out[c] = lerp_f_local(a[c], b[c], alpha);
+}
+
+// cores das anims para o sweep, remapeadas por tema (col[i] = cor da anim i)
+static void idle_anim_remap(const char* theme_name, const float col[NUM_COLOR_ANIMS][3],
+                            float animR[3], float animG[3], float animB[3]) {
+    int dark = strcmp(theme_name, "Dark Default") == 0;
+    // Dark: mapeamento original (anim 2 -> R, 1 -> G, 0 -> B); Light inverte R <-> B
+    memcpy(animR, col[dark ? 2 : 0], 3 * sizeof(float));
+    memcpy(animG, col[1], 3 * sizeof(float));
+    memcpy(animB, col[dark ? 0 : 2], 3 * sizeof(float));
+}
+
+static void idle_anim_colors(float alpha, float animR[3], float animG[3], float animB[3]) {
+    float col[NUM_COLOR_ANIMS][3];
+    for (int i = 0; i < NUM_COLOR_ANIMS; ++i) sim_anim_color(i, alpha, col[i]);
+    idle_anim_remap(currentTheme.name, col, animR, animG, animB);
+}
+
+// tema exibido: interpolado durante a transição; só recalcula quando o progresso mudou
+// (inclui o último frame, que leva o tema exatamente ao alvo)
+static void sim_apply_theme(float alpha) {
+    static float shown_t = 1.0f;
+    float tt = lerp_f(theme_t_prev, theme_t, alpha);
+    if (tt == shown_t) return;
+    shown_t = tt;
+    theme_lerp(&startTheme, &targetTheme, tt, &currentTheme);
+}
+
+// -------------------- idle sweep kernel (scalar / SSE2 / AVX2 / Q15) --------------------
+// Cada termo do sweep tem a forma sin(kx*fx + ky*fy + ph): v0, v1, v2 e o pulse.
+// Como sin(A + B) = sinA*cosB + cosA*sinB, o frame calcula uma vez tabelas de sin/cos
+// por coluna (A = kx*fx) e por linha (B = ky*fy + ph): O(W+H) senos em vez de O(W*H).
+// Os pesos de cor (anims, accent, intensity, gain) também são combinados por frame,
+// então o kernel só faz multiply-adds por pixel.
+//
+// Pipeline inteiro (q15, q15-sse2), para CPUs sem float rápido: as tabelas são pares
+// sin/cos em Q15 tirados de uma LUT (fase em voltas Q32, sem sinf por frame), os pesos
+// viram inteiros de 16 bits e o kernel produz ARGB direto, sem float nem fcol_to_u8.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SWEEP_HAVE_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define SWEEP_TARGET_SSE2 __attribute__((target("sse2")))
+#define SWEEP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SWEEP_TARGET_SSE2
+#define SWEEP_TARGET_AVX2
+#endif
+#endif
+
+#define SWEEP_TERMS 4
+
+#define SWEEP_LUT_BITS 12
+#define SWEEP_LUT_SIZE (1 << SWEEP_LUT_BITS)
+
+// armazenamento das tabelas (cresce sob demanda, reaproveitado entre frames)
+typedef struct {
+    float* data;
+    size_t cap;   // em floats
+    Sint16* qdata; // tabelas Q15 do pipeline inteiro
+    size_t qcap;   // em Sint16
+} SweepTables;
+
+typedef struct {
+    int w, h;
+    float base[3];               // constante por canal (R,G,B)
+    float wt[3][SWEEP_TERMS];    // peso de cada termo por canal
+    const float* col_s[SWEEP_TERMS];  // sin(kx*fx), w entradas
+    const float* col_c[SWEEP_TERMS];  // cos(kx*fx)
+    const float* row_s[SWEEP_TERMS];  // sin(ky*fy + ph), h entradas
+    const float* row_c[SWEEP_TERMS];  // cos(ky*fy + ph)
+
+    // pipeline inteiro: canal = (base_q6 + soma mulhi(sin Q15, wt_q7) + 32) >> 6
+    int fixed;
+    Sint16 base_q6[3];                 // nível 0..255 em Q6
+    Sint16 wt_q7[3][SWEEP_TERMS];      // peso em Q7 do nível (mulhi por Q15 -> Q6)
+    const Sint16* col_q[SWEEP_TERMS];  // pares (sin, cos) por coluna, 2*w entradas
+    const Sint16* row_q[SWEEP_TERMS];  // pares (cos, sin) por linha, 2*h entradas
+} SweepParams;
+
+static Sint16 sweep_sin_lut[SWEEP_LUT_SIZE]; // sin em Q15, uma volta
+static int sweep_fixed = 0;                  // kernel atual usa o pipeline inteiro
+
+static void sweep_lut_init(void) {
+    for (int i = 0; i < SWEEP_LUT_SIZE; ++i)
+        sweep_sin_lut[i] = (Sint16)lrint(sin(6.283185307179586 * i / SWEEP_LUT_SIZE) * 32767.0);
+}
+
+static void sweep_tables_free(SweepTables* t) {
+    free(t->data);
+    free(t->qdata);
+    t->data = NULL;
+    t->qdata = NULL;
+    t->cap = t->qcap = 0;
+}
+
+// pares Q15 de n passos a partir de turns0 voltas, avançando turns_step por passo;
+// a fase é um acumulador Q32 (a volta completa é o overflow natural do Uint32)
+static void sweep_phase_pairs_q15(Sint16* out, int n, double turns0, double turns_step, int cos_first) {
+    const double q32 = 4294967296.0;
+    Uint32 ph = (Uint32)(Uint64)((turns0 - floor(turns0)) * q32);
+    Uint32 step = (Uint32)(Uint64)((turns_step - floor(turns_step)) * q32);
+    for (int i = 0; i < n; ++i) {
+        Sint16 sn = sweep_sin_lut[ph >> (32 - SWEEP_LUT_BITS)];
+        Sint16 cs = sweep_sin_lut[(Uint32)(ph + 0x40000000u) >> (32 - SWEEP_LUT_BITS)];
+        out[2 * i] = cos_first ? cs : sn;
+        out[2 * i + 1] = cos_first ? sn : cs;
+        ph += step;
+    }
+}
+
+static Sint16 sweep_q16_clamp(float v) {
+    long q = lrintf(v);
+    return (Sint16)(q < -32768 ? -32768 : (q > 32767 ? 32767 : q));
+}
+
+static int sweep_params_build_q15(SweepParams* p, SweepTables* tabs, const float kx[SWEEP_TERMS],
+                                  const float ky[SWEEP_TERMS], const float ph[SWEEP_TERMS]) {
+    const int w = p->w, h = p->h;
+    size_t need = (size_t)SWEEP_TERMS * 2 * ((size_t)w + (size_t)h);
+    if (need > tabs->qcap) {
+        Sint16* nd = realloc(tabs->qdata, need * sizeof(Sint16));
+        if (!nd) {
+            SDL_Log("malloc failed for sweep tables");
+            return 0;
+        }
+        tabs->qdata = nd;
+        tabs->qcap = need;
+    }
+    const double inv_2pi = 1.0 / 6.283185307179586;
+    double inv_w = 1.0 / (double)(w > 1 ? w - 1 : 1);
+    double inv_h = 1.0 / (double)(h > 1 ? h - 1 : 1);
+    Sint16* cur = tabs->qdata;
+    for (int k = 0; k < SWEEP_TERMS; ++k) {
+        Sint16* col = cur; cur += 2 * w;
+        Sint16* row = cur; cur += 2 * h;
+        sweep_phase_pairs_q15(col, w, 0.0, kx[k] * inv_2pi * inv_w, 0);
+        sweep_phase_pairs_q15(row, h, ph[k] * inv_2pi, ky[k] * inv_2pi * inv_h, 1);
+        p->col_q[k] = col;
+        p->row_q[k] = row;
+    }
+    for (int c = 0; c < 3; ++c) {
+        p->base_q6[c] = sweep_q16_clamp(p->base[c] * 255.0f * 64.0f);
+        for (int k = 0; k < SWEEP_TERMS; ++k) p->wt_q7[c][k] = sweep_q16_clamp(p->wt[c][k] * 255.0f * 128.0f);
+    }
+    return 1;
+}
+
+// monta coeficientes e tabelas do frame a partir das cores animadas e do tema atual
+static int sweep_params_build(SweepParams* p, SweepTables* tabs, int w, int h,
+                              const float animR[3], const float animG[3], const float animB[3],
+                              const float accent[3], float intensity, float gain) {
+    const float TWO_PI = 6.2831853f;
+    float kx[SWEEP_TERMS], ky[SWEEP_TERMS], ph[SWEEP_TERMS];
+
+    // v0 = 0.5 + 0.5*sin((fx + animR[0]*0.5 + fy*0.3) * 2pi + animR[1]*2.0)
+    kx[0] = TWO_PI;        ky[0] = 0.3f * TWO_PI; ph[0] = animR[0] * 0.5f * TWO_PI + animR[1] * 2.0f;
+    // v1 = 0.5 + 0.5*sin((fx*1.2 + animG[1]*0.6 + fy*0.2) * 2pi + animG[2]*1.5)
+    kx[1] = 1.2f * TWO_PI; ky[1] = 0.2f * TWO_PI; ph[1] = animG[1] * 0.6f * TWO_PI + animG[2] * 1.5f;
+    // v2 = 0.5 + 0.5*sin((fx*0.8 + animB[2]*0.4 + fy*0.1) * 2pi + animB[0]*2.2)
+    kx[2] = 0.8f * TWO_PI; ky[2] = 0.1f * TWO_PI; ph[2] = animB[2] * 0.4f * TWO_PI + animB[0] * 2.2f;
+    // pulse = (0.5 + 0.5*sin((fx + fy) * 12 + animR[0]*6)) * 0.06 * gain
+    kx[3] = 12.0f;         ky[3] = 12.0f;         ph[3] = animR[0] * 6.0f;
+
+    // c = lerp((v0*a0 + v1*a1 + v2*a2) / 3, accent, 0.18) * intensity + pulse, com v = 0.5 + 0.5*s
+    const float mix = (1.0f - 0.18f) * intensity;
+    const float pulse_w = 0.5f * 0.06f * gain;
+    for (int c = 0; c < 3; ++c) {
+        float a0 = animR[c], a1 = animG[c], a2 = animB[c];
+        p->wt[c][0] = 0.5f * a0 / 3.0f * mix;
+        p->wt[c][1] = 0.5f * a1 / 3.0f * mix;
+        p->wt[c][2] = 0.5f * a2 / 3.0f * mix;
+        p->wt[c][3] = pulse_w;
+        p->base[c] = 0.5f * (a0 + a1 + a2) / 3.0f * mix + 0.18f * accent[c] * intensity + pulse_w;
+    }
+
+    p->w = w;
+    p->h = h;
+    p->fixed = sweep_fixed;
+    if (p->fixed) return sweep_params_build_q15(p, tabs, kx, ky, ph);
+
+    size_t need = (size_t)SWEEP_TERMS * 2 * ((size_t)w + (size_t)h);
+    if (need > tabs->cap) {
+        float* nd = realloc(tabs->data, need * sizeof(float));
+        if (!nd) {
+            SDL_Log("malloc failed for sweep tables");
+            return 0;
+        }
+        tabs->data = nd;
+        tabs->cap = need;
+    }
+
+    float inv_w = 1.0f / (float)(w > 1 ? w - 1 : 1);
+    float inv_h = 1.0f / (float)(h > 1 ? h - 1 : 1);
+    float* cur = tabs->data;
+    for (int k = 0; k < SWEEP_TERMS; ++k) {
+        float* cs = cur; cur += w;
+        float* cc = cur; cur += w;
+        float* rs = cur; cur += h;
+        float* rc = cur; cur += h;
+        for (int x = 0; x < w; ++x) {
+            float a = kx[k] * ((float)x * inv_w);
+            cs[x] = sinf(a);
+            cc[x] = cosf(a);
+        }
+        for (int y = 0; y < h; ++y) {
+            float b = ky[k] * ((float)y * inv_h) + ph[k];
+            rs[y] = sinf(b);
+            rc[y] = cosf(b);
+        }
+        p->col_s[k] = cs; p->col_c[k] = cc;
+        p->row_s[k] = rs; p->row_c[k] = rc;
+    }
+    return 1;
+}
+
+// um pixel a partir das tabelas (referência e cauda dos caminhos SIMD)
+static inline Uint32 sweep_pixel(const SweepParams* p, int x, const float rs[SWEEP_TERMS], const float rc[SWEEP_TERMS]) {
+    float col[3] = { p->base[0], p->base[1], p->base[2] };
+    for (int k = 0; k < SWEEP_TERMS; ++k) {
+        float s = p->col_s[k][x] * rc[k] + p->col_c[k][x] * rs[k];
+        for (int c = 0; c < 3; ++c) col[c] += s * p->wt[c][k];
+    }
+    // ARGB8888 in memory
+    return (255u << 24) | ((Uint32)fcol_to_u8(col[0]) << 16) | ((Uint32)fcol_to_u8(col[1]) << 8) | (Uint32)fcol_to_u8(col[2]);
+}
+
+static inline void sweep_row_factors(const SweepParams* p, int y, float rs[SWEEP_TERMS], float rc[SWEEP_TERMS]) {
+    for (int k = 0; k < SWEEP_TERMS; ++k) {
+        rs[k] = p->row_s[k][y];
+        rc[k] = p->row_c[k][y];
+    }
+}
+
+typedef void (*SweepRowsFn)(const SweepParams* p, Uint32* dst, int pitch_px, int y0, int y1);
+
+static void sweep_rows_scalar(const SweepParams* p, Uint32* dst, int pitch_px, int y0, int y1) {
+    for (int y = y0; y < y1; ++y) {
+        float rs[SWEEP_TERMS], rc[SWEEP_TERMS];
+        sweep_row_factors(p, y, rs, rc);
+        Uint32* out = dst + (size_t)y * pitch_px;
+        for (int x = 0; x < p->w; ++x) out[x] = sweep_pixel(p, x, rs, rc);
+    }
+}
+
+#ifdef SWEEP_HAVE_X86
+// mesma conversão de fcol_to_u8: trunc(v*255 + 0.5) saturado em 0..255
+SWEEP_TARGET_SSE2 static inline __m128i sweep_to_u8_sse2(__m128 v) {
+    v = _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f));
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+    return _mm_cvttps_epi32(v);
+}
+
+SWEEP_TARGET_SSE2 static void sweep_rows_sse2(const SweepParams* p, Uint32* dst, int pitch_px, int y0, int y1) {
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+
+    for (int y = y0; y < y1; ++y) {
+        float rs[SWEEP_TERMS], rc[SWEEP_TERMS];
+        sweep_row_factors(p, y, rs, rc);
+        __m128 vrs[SWEEP_TERMS], vrc[SWEEP_TERMS];
+        for (int k = 0; k < SWEEP_TERMS; ++k) { vrs[k] = _mm_set1_ps(rs[k]); vrc[k] = _mm_set1_ps(rc[k]); }
+        Uint32* out = dst + (size_t)y * pitch_px;
+        int x = 0;
+        for (; x + 4 <= p->w; x += 4) {
+            __m128 s[SWEEP_TERMS];
+            for (int k = 0; k < SWEEP_TERMS; ++k)
+                s[k] = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(p->col_s[k] + x), vrc[k]),
+                                  _mm_mul_ps(_mm_loadu_ps(p->col_c[k] + x), vrs[k]));
+            __m128i ch[3];
+            for (int c = 0; c < 3; ++c) {
+                __m128 v = _mm_set1_ps(p->base[c]);
+                for (int k = 0; k < SWEEP_TERMS; ++k) v = _mm_add_ps(v, _mm_mul_ps(s[k], _mm_set1_ps(p->wt[c][k])));
+                ch[c] = sweep_to_u8_sse2(v);
+            }
+            __m128i px = _mm_or_si128(_mm_or_si128(alpha, _mm_slli_epi32(ch[0], 16)),
+                                      _mm_or_si128(_mm_slli_epi32(ch[1], 8), ch[2]));
+            _mm_storeu_si128((__m128i*)(out + x), px);
+        }
+        for (; x < p->w; ++x) out[x] = sweep_pixel(p, x, rs, rc);
+    }
+}
+
+SWEEP_TARGET_AVX2 static inline __m256i sweep_to_u8_avx2(__m256 v) {
+    v = _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f));
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+    return _mm256_cvttps_epi32(v);
+}
+
+SWEEP_TARGET_AVX2 static void sweep_rows_avx2(const SweepParams* p, Uint32* dst, int pitch_px, int y0, int y1) {
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+
+    for (int y = y0; y < y1; ++y) {
+        float rs[SWEEP_TERMS], rc[SWEEP_TERMS];
+        sweep_row_factors(p, y, rs, rc);
+        __m256 vrs[SWEEP_TERMS], vrc[SWEEP_TERMS];
+        for (int k = 0; k < SWEEP_TERMS; ++k) { vrs[k] = _mm256_set1_ps(rs[k]); vrc[k] = _mm256_set1_ps(rc[k]); }
+        Uint32* out = dst + (size_t)y * pitch_px;
+        int x = 0;
+        for (; x + 8 <= p->w; x += 8) {
+            __m256 s[SWEEP_TERMS];
+            for (int k = 0; k < SWEEP_TERMS; ++k)
+                s[k] = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(p->col_s[k] + x), vrc[k]),
+                                     _mm256_mul_ps(_mm256_loadu_ps(p->col_c[k] + x), vrs[k]));
+            __m256i ch[3];
+            for (int c = 0; c < 3; ++c) {
+                __m256 v = _mm256_set1_ps(p->base[c]);
+                for (int k = 0; k < SWEEP_TERMS; ++k) v = _mm256_add_ps(v, _mm256_mul_ps(s[k], _mm256_set1_ps(p->wt[c][k])));
+                ch[c] = sweep_to_u8_avx2(v);
+            }
+            __m256i px = _mm256_or_si256(_mm256_or_si256(alpha, _mm256_slli_epi32(ch[0], 16)),
+                                         _mm256_or_si256(_mm256_slli_epi32(ch[1], 8), ch[2]));
+            _mm256_storeu_si256((__m256i*)(out + x), px);
+        }
+        for (; x < p->w; ++x) out[x] = sweep_pixel(p, x, rs, rc);
+    }
+}
+#endif
+
+// pipeline inteiro, escalar. Mesma aritmética do q15-sse2 (bit a bit na faixa normal):
+// s = (sinA*cosB + cosA*sinB) >> 15, termo = (s * wt_q7) >> 16, canal = (soma + 32) >> 6
+static inline Uint32 sweep_pixel_q15(const SweepParams* p, int x, const Sint16* const rows[SWEEP_TERMS]) {
+    Sint32 acc[3] = { p->base_q6[0], p->base_q6[1], p->base_q6[2] };
+    for (int k = 0; k < SWEEP_TERMS; ++k) {
+        const Sint16* cp = p->col_q[k] + 2 * x;
+        Sint32 sk = ((Sint32)cp[0] * rows[k][0] + (Sint32)cp[1] * rows[k][1]) >> 15;
+        if (sk > 32767) sk = 32767;
+        if (sk < -32768) sk = -32768;
+        for (int c = 0; c < 3; ++c) acc[c] += (sk * p->wt_q7[c][k]) >> 16;
+    }
+    Uint32 px = 255u << 24;
+    for (int c = 0; c < 3; ++c) {
+        Sint32 v = (acc[c] + 32) >> 6;
+        v = v < 0 ? 0 : (v > 255 ? 255 : v);
+        px |= (Uint32)v << (16 - 8 * c);
+    }
+    return px;
+}
+
+static void sweep_rows_q15(const SweepParams* p, Uint32* dst, int pitch_px, int y0, int y1) {
+    for (int y = y0; y < y1; ++y) {
+        const Sint16* rows[SWEEP_TERMS];
+        for (int k = 0; k < SWEEP_TERMS; ++k) rows[k] = p->row_q[k] + 2 * y;
+        Uint32* out = dst + (size_t)y * pitch_px;
+        for (int x = 0; x < p->w; ++x) out[x] = sweep_pixel_q15(p, x, rows);
+    }
+}
+
+#ifdef SWEEP_HAVE_X86
+// 8 pixels por iteração: pmaddwd dá sinA*cosB + cosA*sinB direto dos pares intercalados,
+// pmulhw aplica os pesos e packus satura em 0..255
+SWEEP_TARGET_SSE2 static void sweep_rows_q15_sse2(const SweepParams* p, Uint32* dst, int pitch_px, int y0, int y1) {
+    const __m128i ff = _mm_set1_epi8((char)0xFF);
+    const __m128i round6 = _mm_set1_epi16(32);
+
+    for (int y = y0; y < y1; ++y) {
+        const Sint16* rows[SWEEP_TERMS];
+        __m128i vrow[SWEEP_TERMS];
+        for (int k = 0; k < SWEEP_TERMS; ++k) {
+            rows[k] = p->row_q[k] + 2 * y;
+            // (cosB, sinB) repetido nos 4 pares
+            vrow[k] = _mm_set1_epi32((int)(((Uint32)(Uint16)rows[k][1] << 16) | (Uint16)rows[k][0]));
+        }
+        Uint32* out = dst + (size_t)y * pitch_px;
+        int x = 0;
+        for (; x + 8 <= p->w; x += 8) {
+            __m128i sk[SWEEP_TERMS];
+            for (int k = 0; k < SWEEP_TERMS; ++k) {
+                const __m128i* cp = (const __m128i*)(p->col_q[k] + 2 * x);
+                __m128i lo = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128(cp), vrow[k]), 15);
+                __m128i hi = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128(cp + 1), vrow[k]), 15);
+                sk[k] = _mm_packs_epi32(lo, hi);
+            }
+            __m128i ch[3];
+            for (int c = 0; c < 3; ++c) {
+                __m128i acc = _mm_set1_epi16(p->base_q6[c]);
+                for (int k = 0; k < SWEEP_TERMS; ++k)
+                    acc = _mm_adds_epi16(acc, _mm_mulhi_epi16(sk[k], _mm_set1_epi16(p->wt_q7[c][k])));
+                acc = _mm_srai_epi16(_mm_adds_epi16(acc, round6), 6);
+                ch[c] = _mm_packus_epi16(acc, acc); // 8 bytes úteis
+            }
+            // ARGB8888 na memória (little-endian): B, G, R, A
+            __m128i bg = _mm_unpacklo_epi8(ch[2], ch[1]);
+            __m128i ra = _mm_unpacklo_epi8(ch[0], ff);
+            _mm_storeu_si128((__m128i*)(out + x), _mm_unpacklo_epi16(bg, ra));
+            _mm_storeu_si128((__m128i*)(out + x + 4), _mm_unpackhi_epi16(bg, ra));
+        }
+        for (; x < p->w; ++x) out[x] = sweep_pixel_q15(p, x, rows);
+    }
+}
+#endif
+
+// kernels em ordem de preferência; sweep_select_kernel(NULL) pega o primeiro suportado
+typedef struct {
+    const char* name;
+    SweepRowsFn fn;
+    int fixed;                // usa as tabelas Q15
+    SDL_bool (*supported)(void); // NULL = sempre
+} SweepKernel;
+
+static const SweepKernel sweepKernels[] = {
+#ifdef SWEEP_HAVE_X86
+    { "avx2", sweep_rows_avx2, 0, SDL_HasAVX2 },
+    { "sse2", sweep_rows_sse2, 0, SDL_HasSSE2 },
+    { "q15-sse2", sweep_rows_q15_sse2, 1, SDL_HasSSE2 },
+#endif
+    { "q15", sweep_rows_q15, 1, NULL },
+    { "scalar", sweep_rows_scalar, 0, NULL },
+};
+static const int sweepKernelCount = sizeof(sweepKernels)/sizeof(sweepKernels[0]);
+
+static SweepRowsFn sweep_rows = sweep_rows_scalar;
+static const char* sweep_kernel_name = "scalar";
+
+// name == NULL: o mais largo suportado pela CPU; retorna 0 se 'name' não existe/não roda aqui
+static int sweep_select_kernel(const char* name) {
+    static int lut_ready = 0;
+    if (!lut_ready) { sweep_lut_init(); lut_ready = 1; }
+    for (int i = 0; i < sweepKernelCount; ++i) {
+        const SweepKernel* k = &sweepKernels[i];
+        if (name && strcmp(name, k->name) != 0) continue;
+        if (k->supported && !k->supported()) continue;
+        sweep_rows = k->fn;
+        sweep_kernel_name = k->name;
+        sweep_fixed = k->fixed;
+        SDL_Log("Idle sweep kernel: %s", sweep_kernel_name);
+        return 1;
+    }
+    SDL_Log("Kernel do sweep indisponível: %s", name ? name : "(nenhum)");
+    return 0;
+}
+
+// -------------------- profiler --------------------
+// Zonas de tempo PROF_BEGIN/PROF_END gravadas num ring buffer por thread e exportadas
+// como Chrome trace JSON (chrome://tracing ou ui.perfetto.dev). Desligado, cada zona
+// custa um teste de flag; com -DNO_PROFILER as macros somem e --trace/F9 só avisam.
+
+static SDL_atomic_t prof_enabled; // lido por toda thread que grava zonas
+static const char* prof_path = "trace.json";
+
+#ifndef NO_PROFILER
+#define PROF_RING_SIZE 16384 // eventos por thread; os mais antigos são sobrescritos
+#define PROF_MAX_THREADS 64
+
+typedef struct {
+    const char* name; // literal, não é copiado
+    Uint64 t0, t1;
+} ProfEvent;
+
+typedef struct {
+    SDL_threadID thread;
+    SDL_SpinLock lock; // dona grava, main zera/copia: threads soltas (encoder, writer) não param no F9
+    Uint32 head;  // próximo slot
+    Uint32 count; // eventos válidos (<= PROF_RING_SIZE)
+    ProfEvent ev[PROF_RING_SIZE];
+} ProfRing;
+
+static Uint64 prof_origin = 0;
+static SDL_threadID prof_main_thread = 0;
+static ProfRing* prof_rings[PROF_MAX_THREADS];
+static SDL_atomic_t prof_ring_count;
+static SDL_SpinLock prof_rings_lock; // publicação de prof_rings[i] (raro: 1x por thread)
+
+#define PROF_BEGIN(var) Uint64 var = SDL_AtomicGet(&prof_enabled) ? SDL_GetPerformanceCounter() : 0
+#define PROF_END(var, name) do { if (var) prof_record((name), (var)); } while (0)
+
+static _Thread_local ProfRing* prof_tls = NULL;
+static _Thread_local int prof_tls_failed = 0; // sem slot/memória: não tenta de novo a cada zona
+
+// ring da thread atual (criado no primeiro uso)
+static ProfRing* prof_thread_ring(void) {
+    if (prof_tls) return prof_tls;
+    if (prof_tls_failed) return NULL;
+    prof_tls_failed = 1;
+    int i = SDL_AtomicAdd(&prof_ring_count, 1);
+    if (i >= PROF_MAX_THREADS) return NULL;
+    ProfRing* r = (ProfRing*)calloc(1, sizeof(ProfRing));
+    if (!r) return NULL;
+    r->thread = SDL_ThreadID();
+    SDL_AtomicLock(&prof_rings_lock);
+    prof_rings[i] = r;
+    SDL_AtomicUnlock(&prof_rings_lock);
+    prof_tls = r;
+    return r;
+}
+
+static void prof_record(const char* name, Uint64 t0) {
+    ProfRing* r = prof_thread_ring();
+    if (!r) return;
+    Uint64 t1 = SDL_GetPerformanceCounter();
+    SDL_AtomicLock(&r->lock);
+    ProfEvent* e = &r->ev[r->head];
+    e->name = name;
+    e->t0 = t0;
+    e->t1 = t1;
+    r->head = (r->head + 1) % PROF_RING_SIZE;
+    if (r->count < PROF_RING_SIZE) r->count++;
+    SDL_AtomicUnlock(&r->lock);
+}
+
+static int prof_ring_total(void) {
+    int n = SDL_AtomicGet(&prof_ring_count);
+    return n < PROF_MAX_THREADS ? n : PROF_MAX_THREADS;
+}
+
+// slot i (NULL enquanto a thread dona ainda não publicou o ring)
+static ProfRing* prof_ring_at(int i) {
+    SDL_AtomicLock(&prof_rings_lock);
+    ProfRing* r = prof_rings[i];
+    SDL_AtomicUnlock(&prof_rings_lock);
+    return r;
+}
+
+// start/stop/dump só da main thread; cada ring é zerado/copiado sob o lock dele, então
+// threads que gravam por conta própria (encoder do rewind, writer, hash) podem continuar
+static void prof_start(void) {
+    for (int i = 0; i < prof_ring_total(); ++i) {
+        ProfRing* r = prof_ring_at(i);
+        if (!r) continue;
+        SDL_AtomicLock(&r->lock);
+        r->head = r->count = 0;
+        SDL_AtomicUnlock(&r->lock);
+    }
+    prof_main_thread = SDL_ThreadID();
+    prof_origin = SDL_GetPerformanceCounter();
+    SDL_AtomicSet(&prof_enabled, 1);
+    SDL_Log("Profiler: gravando (F9 para parar e salvar em %s)", prof_path);
+}
+
+static int prof_write_trace(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) { SDL_Log("Profiler: não foi possível abrir %s", path); return 0; }
+    ProfRing* snap = (ProfRing*)malloc(sizeof(ProfRing)); // cópia do ring: fprintf fora do lock
+    if (!snap) { fclose(f); SDL_Log("Profiler: sem memória para salvar %s", path); return 0; }
+    const double us = 1.0e6 / (double)SDL_GetPerformanceFrequency();
+    long total = 0;
+    fprintf(f, "{\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"main_unico\"}}");
+    for (int i = 0; i < prof_ring_total(); ++i) {
+        ProfRing* live = prof_ring_at(i);
+        if (!live) continue;
+        SDL_AtomicLock(&live->lock);
+        memcpy(snap, live, sizeof(ProfRing));
+        SDL_AtomicUnlock(&live->lock);
+        const ProfRing* r = snap;
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+                i, r->thread == prof_main_thread ? "main" : "worker", i);
+        Uint32 first = (r->head + PROF_RING_SIZE - r->count) % PROF_RING_SIZE;
+        for (Uint32 k = 0; k < r->count; ++k) {
+            const ProfEvent* e = &r->ev[(first + k) % PROF_RING_SIZE];
+            if (e->t0 < prof_origin) continue;
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    e->name, i, (double)(e->t0 - prof_origin) * us, (double)(e->t1 - e->t0) * us);
+            total++;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    free(snap);
+    int ok = fclose(f) == 0;
+    SDL_Log("Profiler: %ld zonas salvas em %s", total, path);
+    return ok;
+}
+
+static void prof_stop(void) {
+    SDL_AtomicSet(&prof_enabled, 0);
+    prof_write_trace(prof_path);
+}
+
+static void prof_shutdown(void) {
+    if (SDL_AtomicGet(&prof_enabled)) prof_stop();
+    for (int i = 0; i < prof_ring_total(); ++i) { free(prof_rings[i]); prof_rings[i] = NULL; }
+}
+#else
+#define PROF_BEGIN(var) Uint64 var = 0
+#define PROF_END(var, name) do { (void)(var); } while (0)
+
+// build sem profiler: --trace/F9 avisam uma vez e nada é gravado
+static void prof_start(void) {
+    static int logged = 0;
+    if (!logged) SDL_Log("Profiler: desativado nesta build (NO_PROFILER); %s não será gravado", prof_path);
+    logged = 1;
+}
+
+static void prof_stop(void) {}
+static void prof_shutdown(void) {}
+#endif
+
+// -------------------- worker pool --------------------
+// Pool persistente de threads: pool_submit() publica um lote de 'count' itens e volta
+// na hora; pool_wait() faz a thread chamadora ajudar no lote e espera o último item.
+// Um lote por vez (submit só depois do wait do lote anterior).
+
+typedef void (*PoolJobFn)(void* ctx, int index);
+
+typedef struct {
+    SDL_Thread** threads;
+    int num_threads;       // workers, sem contar a thread que chama pool_wait
+    SDL_mutex* lock;
+    SDL_cond* wake;        // novo lote ou shutdown
+    SDL_cond* done;        // lote concluído
+    PoolJobFn fn;
+    void* ctx;
+    int count;             // itens do lote atual
+    int next;              // próximo item livre
+    int pending;           // itens ainda não concluídos
+    int quit;
+} WorkerPool;
+
+// pega e executa itens do lote atual; chamada com pool->lock travado
+static void pool_drain_locked(WorkerPool* pool) {
+    while (pool->next < pool->count) {
+        int i = pool->next++;
+        PoolJobFn fn = pool->fn;
+        void* ctx = pool->ctx;
+        SDL_UnlockMutex(pool->lock);
+        fn(ctx, i);
+        SDL_LockMutex(pool->lock);
+        if (--pool->pending == 0) SDL_CondBroadcast(pool->done);
+    }
+}
+
+static int pool_worker_main(void* data) {
+    WorkerPool* pool = (WorkerPool*)data;
+    SDL_LockMutex(pool->lock);
+    while (!pool->quit) {
+        pool_drain_locked(pool);
+        if (!pool->quit) SDL_CondWait(pool->wake, pool->lock);
+    }
+    SDL_UnlockMutex(pool->lock);
+    return 0;
+}
+
+static void pool_destroy(WorkerPool* pool);
+
+// num_threads <= 0: um worker por CPU, menos a thread principal (que ajuda no wait)
+static WorkerPool* pool_create(int num_threads) {
+    if (num_threads <= 0) num_threads = SDL_GetCPUCount();
+    int workers = num_threads - 1;
+    if (workers < 0) workers = 0;
+
+    WorkerPool* pool = calloc(1, sizeof(WorkerPool));
+    if (!pool) return NULL;
+    pool->lock = SDL_CreateMutex();
+    pool->wake = SDL_CreateCond();
+    pool->done = SDL_CreateCond();
+    pool->threads = workers > 0 ? calloc((size_t)workers, sizeof(SDL_Thread*)) : NULL;
+    if (!pool->lock || !pool->wake || !pool->done || (workers > 0 && !pool->threads)) {
+        SDL_Log("pool_create failed: %s", SDL_GetError());
+        pool_destroy(pool);
+        return NULL;
+    }
+    for (int i = 0; i < workers; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "pool-%d", i);
+        pool->threads[i] = SDL_CreateThread(pool_worker_main, name, pool);
+        if (!pool->threads[i]) {
+            SDL_Log("SDL_CreateThread failed: %s", SDL_GetError());
+            break;
+        }
+        pool->num_threads++;
+    }
+    return pool;
+}
+
+static void pool_destroy(WorkerPool* pool) {
+    if (!pool) return;
+    if (pool->lock) {
+        SDL_LockMutex(pool->lock);
+        pool->quit = 1;
+        if (pool->wake) SDL_CondBroadcast(pool->wake);
+        SDL_UnlockMutex(pool->lock);
+    }
+    for (int i = 0; i < pool->num_threads; ++i) SDL_WaitThread(pool->threads[i], NULL);
+    free(pool->threads);
+    if (pool->done) SDL_DestroyCond(pool->done);
+    if (pool->wake) SDL_DestroyCond(pool->wake);
+    if (pool->lock) SDL_DestroyMutex(pool->lock);
+    free(pool);
+}
+
+static void pool_submit(WorkerPool* pool, PoolJobFn fn, void* ctx, int count) {
+    SDL_LockMutex(pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->count = count;
+    pool->next = 0;
+    pool->pending = count;
+    if (pool->num_threads > 0) SDL_CondBroadcast(pool->wake);
+    SDL_UnlockMutex(pool->lock);
+}
+
+static void pool_wait(WorkerPool* pool) {
+    SDL_LockMutex(pool->lock);
+    pool_drain_locked(pool);
+    while (pool->pending > 0) SDL_CondWait(pool->done, pool->lock);
+    SDL_UnlockMutex(pool->lock);
+}
+
+// sweep em faixas de linhas: ~4 faixas por thread para equilibrar a carga
+typedef struct {
+    const SweepParams* params;
+    Uint32* dst;
+    int pitch_px;
+    int band_h;
+    Uint64 t_submit;
+    SDL_atomic_t first_us, last_us; // início da primeira faixa / fim da última, desde o submit
+} SweepJob;
+
+static SDL_atomic_t sweep_cpu_us; // soma do tempo das faixas (todas as threads), zerada no join
+
+static void atomic_min_int(SDL_atomic_t* a, int v) {
+    int cur;
+    while (v < (cur = SDL_AtomicGet(a)) && !SDL_AtomicCAS(a, cur, v)) {}
+}
+
+static void atomic_max_int(SDL_atomic_t* a, int v) {
+    int cur;
+    while (v > (cur = SDL_AtomicGet(a)) && !SDL_AtomicCAS(a, cur, v)) {}
+}
+
+static void sweep_job_band(void* ctx, int index) {
+    SweepJob* job = (SweepJob*)ctx;
+    int y0 = index * job->band_h;
+    int y1 = y0 + job->band_h;
+    if (y1 > job->params->h) y1 = job->params->h;
+    PROF_BEGIN(pz);
+    Uint64 t0 = SDL_GetPerformanceCounter();
+    sweep_rows(job->params, job->dst, job->pitch_px, y0, y1);
+    Uint64 t1 = SDL_GetPerformanceCounter();
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    SDL_AtomicAdd(&sweep_cpu_us, (int)((t1 - t0) * 1000000 / freq));
+    atomic_min_int(&job->first_us, (int)((t0 - job->t_submit) * 1000000 / freq));
+    atomic_max_int(&job->last_us, (int)((t1 - job->t_submit) * 1000000 / freq));
+    PROF_END(pz, "sweep band");
+}
+
+// publica o preenchimento de 'dst' no pool; o chamador faz pool_wait() antes de usar os pixels
+static void sweep_submit(WorkerPool* pool, SweepJob* job, const SweepParams* p, Uint32* dst, int pitch_px) {
+    int bands = (pool->num_threads + 1) * 4;
+    int band_h = (p->h + bands - 1) / bands;
+    if (band_h < 8) band_h = 8;
+    job->params = p;
+    job->dst = dst;
+    job->pitch_px = pitch_px;
+    job->band_h = band_h;
+    job->t_submit = SDL_GetPerformanceCounter();
+    SDL_AtomicSet(&job->first_us, 0x7FFFFFFF);
+    SDL_AtomicSet(&job->last_us, 0);
+    pool_submit(pool, sweep_job_band, job, (p->h + band_h - 1) / band_h);
+}
+
+// parede do sweep (primeira faixa começa -> última termina), sem o que o main thread
+// fez entre o submit e o join; chamar depois de pool_wait()
+static float sweep_wall_ms(SweepJob* job) {
+    int first = SDL_AtomicGet(&job->first_us), last = SDL_AtomicGet(&job->last_us);
+    return last > first ? (float)(last - first) / 1000.0f : 0.0f;
+}
+
+// -------------------- background keyframe baking --------------------
+// Modo "Keyframes": o sweep só depende dos ColorAnim, que mudam devagar. Uma thread
+// própria simula as anims à frente (o RNG é do ColorAnim, então o futuro simulado é o
+// mesmo que o main thread vai ver) e renderiza keyframes em baixa resolução num ring
+// limitado a BAKE_MAX_BYTES. No present, os dois keyframes em volta do tempo atual são
+// misturados com alpha mod: uma cópia por keyframe e quase nada de CPU por frame.
+
+#define BAKE_DIV 4                    // keyframes em drawable / BAKE_DIV
+#define BAKE_KF_STEPS (SIM_HZ / 4)    // passos de simulação entre keyframes (0.25 s)
+#define BAKE_MAX_BYTES (16 * 1024 * 1024)
+#define BAKE_MAX_SLOTS 32
+
+typedef struct {
+    SDL_Thread* thread;
+    SDL_mutex* lock;
+    SDL_cond* cond;
+    int quit;
+    int busy;                         // baker renderizando fora do lock
+    // pedido atual (escrito pelo main thread sob lock)
+    unsigned gen;                     // muda a cada restart/stop
+    int active;
+    ColorAnim start[NUM_COLOR_ANIMS]; // estado no keyframe 0
+    char theme_name[64];              // cópia: currentTheme é reescrito todo frame
+    float accent[3], intensity, gain;
+    int w, h, slots;
+    Uint64 tick0;                     // tick da simulação no keyframe 0
+    unsigned theme_gen;               // theme_generation usado no restart
+    unsigned timeline;                // sim_timeline usado no restart
+    Uint32* frames;                   // slots * w * h
+    int produced;                     // keyframes prontos
+    int oldest_needed;                // o consumidor ainda lê deste em diante
+    // só main thread
+    SDL_Texture* tex[2];              // keyframes pares / ímpares
+    int tex_kf[2];                    // keyframe carregado (-1 = nenhum)
+} BgBaker;
+
+static int bg_baker_main(void* arg) {
+    BgBaker* b = (BgBaker*)arg;
+    SweepTables tabs = {0};
+    SweepParams params;
+    ColorAnim sim[NUM_COLOR_ANIMS];
+    unsigned sim_gen = 0;
+
+    SDL_LockMutex(b->lock);
+    while (!b->quit) {
+        if (!b->active || b->produced - b->oldest_needed >= b->slots) {
+            SDL_CondWait(b->cond, b->lock);
+            continue;
+        }
+        if (sim_gen != b->gen) {
+            memcpy(sim, b->start, sizeof(sim));
+            sim_gen = b->gen;
+        }
+        unsigned gen = b->gen;
+        char theme_name[sizeof(b->theme_name)];
+        memcpy(theme_name, b->theme_name, sizeof(theme_name));
+        float accent[3] = { b->accent[0], b->accent[1], b->accent[2] };
+        float intensity = b->intensity, gain = b->gain;
+        int w = b->w, h = b->h;
+        Uint32* dst = b->frames + (size_t)(b->produced % b->slots) * w * h;
+        b->busy = 1;
+        SDL_UnlockMutex(b->lock);
+
+        float col[NUM_COLOR_ANIMS][3], animR[3], animG[3], animB[3];
+        for (int i = 0; i < NUM_COLOR_ANIMS; ++i) get_anim_color(&sim[i], col[i]);
+        idle_anim_remap(theme_name, col, animR, animG, animB);
+        if (sweep_params_build(&params, &tabs, w, h, animR, animG, animB, accent, intensity, gain))
+            sweep_rows(&params, dst, w, 0, h);
+        // mesmos passos de sim_step() até o próximo keyframe
+        for (int i = 0; i < BAKE_KF_STEPS; ++i) step_color_anims(sim, (float)SIM_DT, 1.0f);
+
+        SDL_LockMutex(b->lock);
+        b->busy = 0;
+        if (gen == b->gen) b->produced++;
+        SDL_CondBroadcast(b->cond);
+    }
+    SDL_UnlockMutex(b->lock);
+    sweep_tables_free(&tabs);
+    return 0;
+}
+
+static int bg_baker_init(BgBaker* b) {
+    memset(b, 0, sizeof(*b));
+    b->tex_kf[0] = b->tex_kf[1] = -1;
+    b->lock = SDL_CreateMutex();
+    b->cond = SDL_CreateCond();
+    if (b->lock && b->cond) b->thread = SDL_CreateThread(bg_baker_main, "bg-baker", b);
+    if (!b->thread) SDL_Log("Falha ao criar a thread de keyframes: %s", SDL_GetError());
+    return b->thread != NULL;
+}
+
+static void bg_baker_release_textures(BgBaker* b) {
+    for (int i = 0; i < 2; ++i) {
+        if (b->tex[i]) SDL_DestroyTexture(b->tex[i]);
+        b->tex[i] = NULL;
+        b->tex_kf[i] = -1;
+    }
+}
+
+// para a produção e libera o ring (modo desligado, transição de tema, janela escondida)
+static void bg_baker_stop(BgBaker* b) {
+    if (!b->thread) return;
+    SDL_LockMutex(b->lock);
+    while (b->busy) SDL_CondWait(b->cond, b->lock);
+    b->active = 0;
+    b->gen++;
+    free(b->frames);
+    b->frames = NULL;
+    b->w = b->h = b->slots = 0;
+    SDL_UnlockMutex(b->lock);
+    bg_baker_release_textures(b);
+}
+
+static void bg_baker_destroy(BgBaker* b) {
+    if (b->thread) {
+        SDL_LockMutex(b->lock);
+        b->quit = 1;
+        SDL_CondBroadcast(b->cond);
+        SDL_UnlockMutex(b->lock);
+        SDL_WaitThread(b->thread, NULL);
+        b->thread = NULL;
+    }
+    free(b->frames);
+    b->frames = NULL;
+    bg_baker_release_textures(b);
+    if (b->cond) SDL_DestroyCond(b->cond);
+    if (b->lock) SDL_DestroyMutex(b->lock);
+    b->cond = NULL;
+    b->lock = NULL;
+}
+
+// recomeça o ring a partir de 'start' (estado no tick 'tick0') com o tema atual.
+// Se faltar memória fica inativo até o próximo restart (o fundo segue ao vivo).
+static void bg_baker_restart(BgBaker* b, SDL_Renderer* renderer, const ColorAnim* start, Uint64 tick0, int w, int h) {
+    if (!b->thread) return;
+    size_t frame_bytes = (size_t)w * h * sizeof(Uint32);
+    int slots = (int)(BAKE_MAX_BYTES / frame_bytes);
+    if (slots > BAKE_MAX_SLOTS) slots = BAKE_MAX_SLOTS;
+    if (slots < 3) slots = 3;
+
+    SDL_LockMutex(b->lock);
+    while (b->busy) SDL_CondWait(b->cond, b->lock);
+    int resized = w != b->w || h != b->h || slots != b->slots || !b->frames;
+    if (resized) {
+        free(b->frames);
+        b->frames = (Uint32*)malloc(frame_bytes * (size_t)slots);
+        if (!b->frames) SDL_Log("malloc failed for background keyframes (%d x %zu bytes)", slots, frame_bytes);
+    }
+    b->w = w;
+    b->h = h;
+    b->slots = slots;
+    memcpy(b->start, start, sizeof(b->start));
+    snprintf(b->theme_name, sizeof(b->theme_name), "%s", currentTheme.name);
+    b->accent[0] = currentTheme.accent.r;
+    b->accent[1] = currentTheme.accent.g;
+    b->accent[2] = currentTheme.accent.b;
+    b->intensity = currentTheme.idle_intensity;
+    b->gain = currentTheme.idle_gain;
+    b->tick0 = tick0;
+    b->theme_gen = theme_generation;
+    b->timeline = sim_timeline;
+    b->produced = 0;
+    b->oldest_needed = 0;
+    b->gen++;
+    b->active = b->frames != NULL;
+    SDL_CondBroadcast(b->cond);
+    SDL_UnlockMutex(b->lock);
+
+    if (resized) bg_baker_release_textures(b);
+    b->tex_kf[0] = b->tex_kf[1] = -1;
+    for (int i = 0; i < 2 && b->active; ++i) {
+        if (b->tex[i]) continue;
+        b->tex[i] = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+        if (!b->tex[i]) { SDL_Log("CreateTexture failed: %s", SDL_GetError()); continue; }
+        SDL_SetTextureScaleMode(b->tex[i], SDL_ScaleModeLinear);
+    }
+}
+
+// 'pos' em keyframes (fracionário). Retorna 1 se os dois keyframes em volta já estão
+// prontos; avisa o baker de que os anteriores podem ser sobrescritos.
+static int bg_baker_acquire(BgBaker* b, double pos) {
+    if (!b->thread || pos < 0.0) return 0;
+    int kf = (int)pos;
+    SDL_LockMutex(b->lock);
+    // antes de oldest_needed o slot já pode ter sido reusado por um keyframe mais novo
+    int ok = b->active && b->tex[0] && b->tex[1] && kf >= b->oldest_needed && kf + 1 < b->produced;
+    int keep = kf < b->produced ? kf : b->produced;
+    if (keep > b->oldest_needed) {
+        b->oldest_needed = keep;
+        SDL_CondSignal(b->cond);
+    }
+    SDL_UnlockMutex(b->lock);
+    return ok;
+}
+
+// 'tick' voltou para antes do keyframe mais antigo guardado (run-ahead reduzido, rewind):
+// o ring não tem mais esse trecho e precisa recomeçar. oldest_needed só muda no main thread.
+static int bg_baker_behind(const BgBaker* b, Uint64 tick) {
+    return b->w && tick < b->tick0 + (Uint64)b->oldest_needed * BAKE_KF_STEPS;
+}
+
+// só depois de bg_baker_acquire() == 1 no mesmo frame: os slots lidos não mudam
+static void bg_baker_draw(BgBaker* b, SDL_Renderer* renderer, double pos, const SDL_Rect* dst) {
+    int kf = (int)pos;
+    float f = (float)(pos - kf);
+    for (int j = 0; j < 2; ++j) {
+        int want = kf + j;
+        int t = want & 1; // avançar um keyframe recarrega só uma textura
+        if (b->tex_kf[t] != want) {
+            const Uint32* src = b->frames + (size_t)(want % b->slots) * b->w * b->h;
+            SDL_UpdateTexture(b->tex[t], NULL, src, b->w * (int)sizeof(Uint32));
+            b->tex_kf[t] = want;
+        }
+    }
+    SDL_Texture* a = b->tex[kf & 1];
+    SDL_Texture* c = b->tex[(kf + 1) & 1];
+    SDL_SetTextureBlendMode(a, SDL_BLENDMODE_NONE);
+    SDL_RenderCopy(renderer, a, NULL, dst);
+    SDL_SetTextureBlendMode(c, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureAlphaMod(c, (Uint8)(f * 255.0f + 0.5f));
+    SDL_RenderCopy(renderer, c, NULL, dst);
+}
+
+// -------------------- biblioteca de cartuchos --------------------
+// Cartucho -> Biblioteca: todos os .nds de um diretório (--library DIR, padrão "roms").
+// Uma thread própria lê o índice em disco (library.idx, registros binários chaveados
+// por nome + tamanho + mtime) e publica na hora; depois lista o diretório e só mapeia
+// e calcula CRC32/SHA-1 dos arquivos novos ou alterados, em paralelo num WorkerPool
+// só dela. Os ícones decodificados ficam num único atlas (library.thumbs) que vira
+// uma textura; abrir a Biblioteca ou o Info mostra o que já foi publicado, sem scan.
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+#define LIB_NAME_MAX 256
+#define LIB_ATLAS_COLS 64                    // 64 x 32 px = atlas de 2048 px de largura
+#define LIB_ATLAS_MAX (LIB_ATLAS_COLS * 64)  // até 4096 ícones (2048 x 2048)
+#define LIB_HASH_CHUNK (1 << 20)
+#define LIB_INDEX_MAGIC "NDSLIB01"
+#define LIB_THUMBS_MAGIC "NDSTHB01"
+#define LIB_ROW_H 40
+
+typedef struct {
+    char name[LIB_NAME_MAX];  // nome do arquivo dentro do diretório
+    Uint64 size;
+    Sint64 mtime;
+    Uint32 crc32;
+    Uint8 sha1[20];
+    char game_code[5];
+    Uint8 header_ok;
+    Uint8 readable;           // 0 = não deu para mapear no último scan
+    char title[96];           // título do banner (ou do cabeçalho)
+    Sint32 thumb;             // slot no atlas (-1 = sem ícone)
+} LibEntry;
+
+typedef struct {
+    char magic[8];
+    Uint32 record_size;       // sizeof(LibEntry): layout diferente = índice descartado
+    Uint32 count;
+} LibIndexHeader;
+
+typedef struct {
+    char magic[8];
+    Uint32 cols, rows;        // em ícones de 32x32
+} LibThumbsHeader;
+
+typedef struct {
+    char dir[512];
+    SDL_mutex* lock;
+    // publicado pela thread de scan (trocado inteiro sob lock)
+    LibEntry* entries;
+    int count;
+    Uint32* atlas;            // (LIB_ATLAS_COLS * 32) x (atlas_rows * 32) ARGB
+    int atlas_rows;
+    unsigned generation;
+    // scan
+    SDL_Thread* thread;
+    SDL_atomic_t running;
+    SDL_atomic_t quit;
+    SDL_atomic_t scan_done, scan_total; // arquivos a hashear neste scan
+    WorkerPool* hash_pool;    // criado no primeiro scan com algo a hashear; vive até o destroy
+    // main thread
+    SDL_Texture* atlas_tex;
+    unsigned atlas_gen;
+    int scroll;
+} Library;
+
+static Library library = {0};
+
+// CRC32 (IEEE, refletido) slice-by-8
+static Uint32 crc32_tab[8][256];
+
+static void crc32_init(void) {
+    for (Uint32 i = 0; i < 256; ++i) {
+        Uint32 c = i;
+        for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc32_tab[0][i] = c;
+    }
+    for (int t = 1; t < 8; ++t)
+        for (int i = 0; i < 256; ++i) crc32_tab[t][i] = (crc32_tab[t - 1][i] >> 8) ^ crc32_tab[0][crc32_tab[t - 1][i] & 0xFF];
+}
+
+static Uint32 crc32_update(Uint32 crc, const Uint8* p, size_t n) {
+    crc = ~crc;
+    while (n >= 8) {
+        Uint32 a = crc ^ ((Uint32)p[0] | (Uint32)p[1] << 8 | (Uint32)p[2] << 16 | (Uint32)p[3] << 24);
+        Uint32 b = (Uint32)p[4] | (Uint32)p[5] << 8 | (Uint32)p[6] << 16 | (Uint32)p[7] << 24;
+        crc = crc32_tab[7][a & 0xFF] ^ crc32_tab[6][(a >> 8) & 0xFF] ^ crc32_tab[5][(a >> 16) & 0xFF] ^ crc32_tab[4][a >> 24] ^
+              crc32_tab[3][b & 0xFF] ^ crc32_tab[2][(b >> 8) & 0xFF] ^ crc32_tab[1][(b >> 16) & 0xFF] ^ crc32_tab[0][b >> 24];
+        p += 8;
+        n -= 8;
+    }
+    while (n--) crc = crc32_tab[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// SHA-1 (FIPS 180-4)
+typedef struct {
+    Uint32 h[5];
+    Uint64 len;
+    Uint8 buf[64];
+    int fill;
+} Sha1;
+
+#define SHA1_ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1_block(Sha1* s, const Uint8* p) {
+    Uint32 w[80];
+    for (int i = 0; i < 16; ++i) w[i] = (Uint32)p[4 * i] << 24 | (Uint32)p[4 * i + 1] << 16 | (Uint32)p[4 * i + 2] << 8 | p[4 * i + 3];
+    for (int i = 16; i < 80; ++i) w[i] = SHA1_ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    Uint32 a = s->h[0], b = s->h[1], c = s->h[2], d = s->h[3], e = s->h[4];
+    for (int i = 0; i < 80; ++i) {
+        Uint32 f, k;
+        if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+        else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+        else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+        else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+        Uint32 t = SHA1_ROL(a, 5) + f + e + k + w[i];
+        e = d; d = c; c = SHA1_ROL(b, 30); b = a; a = t;
+    }
+    s->h[0] += a; s->h[1] += b; s->h[2] += c; s->h[3] += d; s->h[4] += e;
+}
+
+static void sha1_init(Sha1* s) {
+    static const Uint32 iv[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    memcpy(s->h, iv, sizeof(iv));
+    s->len = 0;
+    s->fill = 0;
+}
+
+static void sha1_update(Sha1* s, const Uint8* p, size_t n) {
+    s->len += n;
+    if (s->fill) {
+        while (n && s->fill < 64) { s->buf[s->fill++] = *p++; n--; }
+        if (s->fill < 64) return;
+        sha1_block(s, s->buf);
+        s->fill = 0;
+    }
+    for (; n >= 64; p += 64, n -= 64) sha1_block(s, p);
+    memcpy(s->buf, p, n);
+    s->fill = (int)n;
+}
+
+static void sha1_final(Sha1* s, Uint8 out[20]) {
+    Uint64 bits = s->len * 8;
+    Uint8 pad = 0x80;
+    sha1_update(s, &pad, 1);
+    pad = 0;
+    while (s->fill != 56) sha1_update(s, &pad, 1);
+    Uint8 lenb[8];
+    for (int i = 0; i < 8; ++i) lenb[i] = (Uint8)(bits >> (56 - 8 * i));
+    sha1_update(s, lenb, 8);
+    for (int i = 0; i < 20; ++i) out[i] = (Uint8)(s->h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+static int lib_cmp_entry(const void* a, const void* b) {
+    return strcmp(((const LibEntry*)a)->name, ((const LibEntry*)b)->name);
+}
+
+static int lib_has_rom_ext(const char* name) {
+    size_t n = strlen(name);
+    return n > 4 && SDL_strcasecmp(name + n - 4, ".nds") == 0;
+}
+
+// arquivos .nds de 'dir' (nome, tamanho, mtime) em *out, ordenados por nome; -1 se não abrir
+static int lib_list_dir(const char* dir, LibEntry** out) {
+    int count = 0, cap = 0;
+    LibEntry* v = NULL;
+#ifdef _WIN32
+    char pattern[600];
+    snprintf(pattern, sizeof(pattern), "%s\\*.nds", dir);
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA(pattern, &fd);
+    if (h == INVALID_HANDLE_VALUE) { *out = NULL; return GetLastError() == ERROR_FILE_NOT_FOUND ? 0 : -1; }
+    do {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        if (strlen(fd.cFileName) >= LIB_NAME_MAX) continue;
+        Uint64 size = (Uint64)fd.nFileSizeHigh << 32 | fd.nFileSizeLow;
+        Sint64 mtime = (Sint64)((Uint64)fd.ftLastWriteTime.dwHighDateTime << 32 | fd.ftLastWriteTime.dwLowDateTime);
+        const char* name = fd.cFileName;
+#else
+    DIR* d = opendir(dir);
+    if (!d) { *out = NULL; return -1; }
+    struct dirent* de;
+    while ((de = readdir(d)) != NULL) {
+        const char* name = de->d_name;
+        if (!lib_has_rom_ext(name) || strlen(name) >= LIB_NAME_MAX) continue;
+        char full[1024];
+        struct stat st;
+        snprintf(full, sizeof(full), "%s/%s", dir, name);
+        if (stat(full, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        Uint64 size = (Uint64)st.st_size;
+        Sint64 mtime = (Sint64)st.st_mtime;
+#endif
+        if (count == cap) {
+            cap = cap ? cap * 2 : 256;
+            LibEntry* nv = (LibEntry*)realloc(v, sizeof(LibEntry) * (size_t)cap);
+            if (!nv) break;
+            v = nv;
+        }
+        LibEntry* e = &v[count++];
+        memset(e, 0, sizeof(*e));
+        snprintf(e->name, sizeof(e->name), "%s", name);
+        e->size = size;
+        e->mtime = mtime;
+        e->thumb = -1;
+#ifdef _WIN32
+    } while (FindNextFileA(h, &fd));
+    FindClose(h);
+#else
+    }
+    closedir(d);
+#endif
+    if (count > 1) qsort(v, (size_t)count, sizeof(LibEntry), lib_cmp_entry);
+    *out = v;
+    return count;
+}
+
+static void lib_path(const Library* lib, const char* name, char* out, size_t n) {
+    snprintf(out, n, "%s/%s", lib->dir, name);
+}
+
+// índice + atlas do disco; 0 se não existem ou não batem com este layout
+static int lib_load_index(Library* lib, LibEntry** entries, int* count, Uint32** atlas, int* atlas_rows) {
+    char path[600];
+    *entries = NULL; *count = 0; *atlas = NULL; *atlas_rows = 0;
+    lib_path(lib, "library.idx", path, sizeof(path));
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+    LibIndexHeader h;
+    int ok = fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, LIB_INDEX_MAGIC, 8) == 0 &&
+             h.record_size == sizeof(LibEntry) && h.count < 1000000;
+    LibEntry* v = ok && h.count ? (LibEntry*)malloc(sizeof(LibEntry) * h.count) : NULL;
+    if (ok && h.count && (!v || fread(v, sizeof(LibEntry), h.count, f) != h.count)) ok = 0;
+    fclose(f);
+    if (!ok) { free(v); SDL_Log("Biblioteca: índice %s ignorado (formato diferente)", path); return 0; }
+    // strings vêm do disco: um índice cortado/corrompido não pode deixar %s/drawText sem fim
+    for (Uint32 i = 0; i < h.count; ++i) {
+        v[i].name[LIB_NAME_MAX - 1] = '\0';
+        v[i].title[sizeof(v[i].title) - 1] = '\0';
+        v[i].game_code[sizeof(v[i].game_code) - 1] = '\0';
+    }
+
+    // atlas: sem ele os ícones somem até o próximo rescan, o índice continua valendo
+    lib_path(lib, "library.thumbs", path, sizeof(path));
+    f = fopen(path, "rb");
+    LibThumbsHeader th;
+    Uint32* px = NULL;
+    if (f && fread(&th, sizeof(th), 1, f) == 1 && memcmp(th.magic, LIB_THUMBS_MAGIC, 8) == 0 &&
+        th.cols == LIB_ATLAS_COLS && th.rows <= LIB_ATLAS_MAX / LIB_ATLAS_COLS) {
+        size_t n = (size_t)LIB_ATLAS_COLS * 32 * th.rows * 32;
+        px = n ? (Uint32*)malloc(n * sizeof(Uint32)) : NULL;
+        if (px && fread(px, sizeof(Uint32), n, f) == n) *atlas_rows = (int)th.rows;
+        else { free(px); px = NULL; }
+    }
+    if (f) fclose(f);
+    for (Uint32 i = 0; i < h.count; ++i) {
+        if (!px || v[i].thumb < -1 || v[i].thumb >= *atlas_rows * LIB_ATLAS_COLS) v[i].thumb = -1;
+    }
+    *entries = v; *count = (int)h.count; *atlas = px;
+    return 1;
+}
+
+// grava num .tmp e renomeia, para um crash no meio não deixar um índice cortado
+static int lib_write_file(const char* path, const void* head, size_t head_n, const void* body, size_t body_n) {
+    char tmp[640];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "wb");
+    if (!f) { SDL_Log("Biblioteca: não foi possível gravar %s", tmp); return 0; }
+    int ok = fwrite(head, 1, head_n, f) == head_n && (body_n == 0 || fwrite(body, 1, body_n, f) == body_n);
+    ok = fclose(f) == 0 && ok;
+#ifdef _WIN32
+    remove(path); // rename do Windows não substitui
+#endif
+    if (ok && rename(tmp, path) == 0) return 1;
+    remove(tmp);
+    SDL_Log("Biblioteca: falha ao gravar %s", path);
+    return 0;
+}
+
+static void lib_save_index(Library* lib, const LibEntry* v, int count, const Uint32* atlas, int atlas_rows) {
+    char path[600];
+    LibIndexHeader h;
+    memcpy(h.magic, LIB_INDEX_MAGIC, 8);
+    h.record_size = sizeof(LibEntry);
+    h.count = (Uint32)count;
+    lib_path(lib, "library.idx", path, sizeof(path));
+    lib_write_file(path, &h, sizeof(h), v, sizeof(LibEntry) * (size_t)count);
+    LibThumbsHeader th;
+    memcpy(th.magic, LIB_THUMBS_MAGIC, 8);
+    th.cols = LIB_ATLAS_COLS;
+    th.rows = (Uint32)atlas_rows;
+    lib_path(lib, "library.thumbs", path, sizeof(path));
+    lib_write_file(path, &th, sizeof(th), atlas, (size_t)LIB_ATLAS_COLS * 32 * atlas_rows * 32 * sizeof(Uint32));
+}
+
+// troca o conteúdo publicado; os arrays antigos são liberados aqui
+static void lib_publish(Library* lib, LibEntry* entries, int count, Uint32* atlas, int atlas_rows) {
+    SDL_LockMutex(lib->lock);
+    LibEntry* old_e = lib->entries;
+    Uint32* old_a = lib->atlas;
+    lib->entries = entries;
+    lib->count = count;
+    lib->atlas = atlas;
+    lib->atlas_rows = atlas_rows;
+    lib->generation++;
+    SDL_UnlockMutex(lib->lock);
+    free(old_e);
+    free(old_a);
+}
+
+static void lib_copy_thumb(Uint32* dst_atlas, int dst_slot, const Uint32* src, int src_pitch) {
+    Uint32* d = dst_atlas + (size_t)(dst_slot / LIB_ATLAS_COLS) * 32 * LIB_ATLAS_COLS * 32 + (dst_slot % LIB_ATLAS_COLS) * 32;
+    for (int y = 0; y < 32; ++y) memcpy(d + (size_t)y * LIB_ATLAS_COLS * 32, src + (size_t)y * src_pitch, 32 * sizeof(Uint32));
+}
+
+// copia um título UTF-8 cortando antes de um caractere que não cabe inteiro
+static void lib_copy_title(char* dst, size_t n, const char* src) {
+    size_t len = strlen(src);
+    if (len >= n) {
+        len = n - 1;
+        while (len > 0 && ((Uint8)src[len] & 0xC0) == 0x80) len--;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+typedef struct {
+    Library* lib;
+    LibEntry* entries;
+    const int* todo;          // índices em entries a hashear
+    Uint32 (*icons)[32 * 32]; // ícone de cada item de todo
+    Uint8* has_icon;
+} LibHashJob;
+
+// um arquivo por item: mapeia, CRC32 + SHA-1 no mesmo passe, cabeçalho e banner
+static void lib_hash_job(void* ctx, int index) {
+    LibHashJob* job = (LibHashJob*)ctx;
+    LibEntry* e = &job->entries[job->todo[index]];
+    char full[1024];
+    Cartridge c;
+    lib_path(job->lib, e->name, full, sizeof(full));
+    if (!SDL_AtomicGet(&job->lib->quit) && cart_map(&c, full)) {
+        PROF_BEGIN(pz);
+        Uint32 crc = 0;
+        Sha1 sha;
+        sha1_init(&sha);
+        for (size_t off = 0; off < c.size && !SDL_AtomicGet(&job->lib->quit); off += LIB_HASH_CHUNK) {
+            size_t n = c.size - off < LIB_HASH_CHUNK ? c.size - off : LIB_HASH_CHUNK;
+            crc = crc32_update(crc, c.data + off, n);
+            sha1_update(&sha, c.data + off, n);
+        }
+        e->crc32 = crc;
+        sha1_final(&sha, e->sha1);
+        e->header_ok = (Uint8)cart_header(&c);
+        memcpy(e->game_code, c.game_code, sizeof(e->game_code));
+        lib_copy_title(e->title, sizeof(e->title), c.game_title);
+        if (cart_banner(&c)) {
+            if (c.banner_title[0]) lib_copy_title(e->title, sizeof(e->title), c.banner_title);
+            memcpy(job->icons[index], c.icon, sizeof(c.icon));
+            job->has_icon[index] = 1;
+        }
+        e->readable = 1;
+        cart_unmap(&c);
+        PROF_END(pz, "library hash");
+    }
+    SDL_AtomicAdd(&job->lib->scan_done, 1);
+}
+
+static int lib_scan_main(void* arg) {
+    Library* lib = (Library*)arg;
+    LibEntry* old = NULL;
+    Uint32* old_atlas = NULL;
+    int old_count = 0, old_rows = 0;
+    Uint64 t0 = SDL_GetPerformanceCounter();
+
+    // 1) o que já se sabia: publicar antes de tocar no diretório
+    SDL_LockMutex(lib->lock);
+    int have = lib->generation > 0;
+    SDL_UnlockMutex(lib->lock);
+    if (!have && lib_load_index(lib, &old, &old_count, &old_atlas, &old_rows)) {
+        LibEntry* pub = old_count ? (LibEntry*)malloc(sizeof(LibEntry) * (size_t)old_count) : NULL;
+        size_t apx = (size_t)LIB_ATLAS_COLS * 32 * old_rows * 32;
+        Uint32* pub_atlas = apx ? (Uint32*)malloc(apx * sizeof(Uint32)) : NULL;
+        if (pub) memcpy(pub, old, sizeof(LibEntry) * (size_t)old_count);
+        if (pub_atlas) memcpy(pub_atlas, old_atlas, apx * sizeof(Uint32));
+        lib_publish(lib, pub, pub ? old_count : 0, pub_atlas, pub_atlas ? old_rows : 0);
+    } else if (have) {
+        // rescan: o publicado é a base
+        SDL_LockMutex(lib->lock);
+        old_count = lib->count;
+        old_rows = lib->atlas_rows;
+        size_t apx = (size_t)LIB_ATLAS_COLS * 32 * old_rows * 32;
+        old = old_count ? (LibEntry*)malloc(sizeof(LibEntry) * (size_t)old_count) : NULL;
+        old_atlas = apx ? (Uint32*)malloc(apx * sizeof(Uint32)) : NULL;
+        if (old) memcpy(old, lib->entries, sizeof(LibEntry) * (size_t)old_count);
+        else old_count = 0;
+        if (old_atlas) memcpy(old_atlas, lib->atlas, apx * sizeof(Uint32));
+        else old_rows = 0;
+        SDL_UnlockMutex(lib->lock);
+    }
+
+    // 2) diretório atual; entradas com mesmo nome + tamanho + mtime são reaproveitadas
+    LibEntry* cur = NULL;
+    int count = lib_list_dir(lib->dir, &cur);
+    if (count < 0) {
+        SDL_Log("Biblioteca: diretório %s não encontrado", lib->dir);
+        free(old);
+        free(old_atlas);
+        SDL_AtomicSet(&lib->running, 0);
+        return 0;
+    }
+    int* todo = count ? (int*)malloc(sizeof(int) * (size_t)count) : NULL;
+    int* reuse_thumb = count ? (int*)malloc(sizeof(int) * (size_t)count) : NULL;
+    int ntodo = 0;
+    for (int i = 0; i < count && todo && reuse_thumb; ++i) {
+        LibEntry* e = &cur[i];
+        const LibEntry* o = old_count ? (const LibEntry*)bsearch(e, old, (size_t)old_count, sizeof(LibEntry), lib_cmp_entry) : NULL;
+        reuse_thumb[i] = -1;
+        if (o && o->size == e->size && o->mtime == e->mtime && o->readable) {
+            *e = *o;
+            reuse_thumb[i] = o->thumb < old_rows * LIB_ATLAS_COLS ? o->thumb : -1;
+        } else {
+            todo[ntodo++] = i;
+        }
+    }
+
+    // 3) hash dos novos/alterados num pool próprio (metade das CPUs: o sweep continua rodando),
+    // reaproveitado entre scans: reabrir a Biblioteca não cria threads novas
+    SDL_AtomicSet(&lib->scan_done, 0);
+    SDL_AtomicSet(&lib->scan_total, ntodo);
+    Uint32 (*icons)[32 * 32] = ntodo ? malloc(sizeof(*icons) * (size_t)ntodo) : NULL;
+    Uint8* has_icon = ntodo ? (Uint8*)calloc((size_t)ntodo, 1) : NULL;
+    if (ntodo && icons && has_icon) {
+        if (!lib->hash_pool) {
+            int threads = SDL_GetCPUCount() / 2;
+            lib->hash_pool = pool_create(threads < 1 ? 1 : threads);
+        }
+        LibHashJob job = { lib, cur, todo, icons, has_icon };
+        if (lib->hash_pool) {
+            pool_submit(lib->hash_pool, lib_hash_job, &job, ntodo);
+            pool_wait(lib->hash_pool);
+        } else {
+            for (int i = 0; i < ntodo; ++i) lib_hash_job(&job, i);
+        }
+    }
+
+    // 4) atlas novo, compacto: ícones reaproveitados + recém-decodificados
+    int slots = 0;
+    for (int i = 0; i < count && reuse_thumb; ++i) if (reuse_thumb[i] >= 0) slots++;
+    for (int t = 0; t < ntodo && has_icon; ++t) if (has_icon[t]) slots++;
+    if (slots > LIB_ATLAS_MAX) slots = LIB_ATLAS_MAX;
+    int rows = (slots + LIB_ATLAS_COLS - 1) / LIB_ATLAS_COLS;
+    Uint32* atlas = rows ? (Uint32*)calloc((size_t)LIB_ATLAS_COLS * 32 * rows * 32, sizeof(Uint32)) : NULL;
+    int next = 0;
+    for (int i = 0; i < count && reuse_thumb; ++i) {
+        int s = reuse_thumb[i];
+        cur[i].thumb = -1;
+        if (s < 0 || !atlas || next >= slots) continue;
+        const Uint32* src = old_atlas + (size_t)(s / LIB_ATLAS_COLS) * 32 * LIB_ATLAS_COLS * 32 + (s % LIB_ATLAS_COLS) * 32;
+        lib_copy_thumb(atlas, next, src, LIB_ATLAS_COLS * 32);
+        cur[i].thumb = next++;
+    }
+    for (int t = 0; t < ntodo && has_icon; ++t) {
+        if (!has_icon[t] || !atlas || next >= slots) continue;
+        lib_copy_thumb(atlas, next, icons[t], 32);
+        cur[todo[t]].thumb = next++;
+    }
+
+    int aborted = SDL_AtomicGet(&lib->quit);
+    if (!aborted) {
+        if (ntodo > 0 || count != old_count) lib_save_index(lib, cur, count, atlas, rows);
+        SDL_Log("Biblioteca: %d ROM(s), %d hasheada(s) em %.0f ms", count, ntodo,
+                (double)(SDL_GetPerformanceCounter() - t0) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+        lib_publish(lib, cur, count, atlas, rows);
+    } else {
+        free(cur);
+        free(atlas);
+    }
+    free(icons);
+    free(has_icon);
+    free(todo);
+    free(reuse_thumb);
+    free(old);
+    free(old_atlas);
+    SDL_AtomicSet(&lib->running, 0);
+    return 0;
+}
+
+static int library_init(Library* lib, const char* dir) {
+    memset(lib, 0, sizeof(*lib));
+    snprintf(lib->dir, sizeof(lib->dir), "%s", dir);
+    crc32_init();
+    lib->lock = SDL_CreateMutex();
+    if (!lib->lock) SDL_Log("Biblioteca: %s", SDL_GetError());
+    return lib->lock != NULL;
+}
+
+// (re)scan em segundo plano; não faz nada se já houver um rodando
+static void library_scan(Library* lib) {
+    if (!lib->lock || SDL_AtomicGet(&lib->running)) return;
+    if (lib->thread) SDL_WaitThread(lib->thread, NULL); // scan anterior já terminou
+    SDL_AtomicSet(&lib->running, 1);
+    lib->thread = SDL_CreateThread(lib_scan_main, "library-scan", lib);
+    if (!lib->thread) {
+        SDL_Log("Biblioteca: falha ao criar a thread de scan: %s", SDL_GetError());
+        SDL_AtomicSet(&lib->running, 0);
+    }
+}
+
+static void library_destroy(Library* lib) {
+    SDL_AtomicSet(&lib->quit, 1);
+    if (lib->thread) SDL_WaitThread(lib->thread, NULL);
+    pool_destroy(lib->hash_pool);
+    if (lib->atlas_tex) SDL_DestroyTexture(lib->atlas_tex);
+    free(lib->entries);
+    free(lib->atlas);
+    if (lib->lock) SDL_DestroyMutex(lib->lock);
+    memset(lib, 0, sizeof(*lib));
+}
+
+// muda quando a lista, o progresso do scan ou o scroll mudam (UI retida)
+static Uint32 library_ui_stamp(Library* lib) {
+    SDL_LockMutex(lib->lock);
+    Uint32 gen = lib->generation;
+    SDL_UnlockMutex(lib->lock);
+    return gen * 2654435761u ^ (Uint32)SDL_AtomicGet(&lib->scan_done) << 12 ^ (Uint32)lib->scroll ^
+           (Uint32)SDL_AtomicGet(&lib->running) << 31;
+}
+
+// linhas abaixo do status; limitadas para caber no hit-test index
+static int library_visible_rows(const Modal* m) {
+    return clamp_int((m->rect.h - 72) / LIB_ROW_H, 1, 48);
+}
+
+static SDL_Rect libraryRowRect(const Modal* m, int row) {
+    SDL_Rect r = { m->rect.x + 8, m->rect.y + 64 + row * LIB_ROW_H, m->rect.w - 16, LIB_ROW_H - 1 };
+    return r;
+}
+
+static void library_scroll_by(Library* lib, const Modal* m, int delta) {
+    SDL_LockMutex(lib->lock);
+    int max_scroll = lib->count - library_visible_rows(m);
+    SDL_UnlockMutex(lib->lock);
+    lib->scroll = clamp_int(lib->scroll + delta, 0, max_scroll > 0 ? max_scroll : 0);
+}
+
+// caminho completo da entrada mostrada na linha 'row' do modal; 0 se a linha está vazia
+static int library_row_path(Library* lib, int row, char* out, size_t n) {
+    int ok = 0;
+    SDL_LockMutex(lib->lock);
+    int i = lib->scroll + row;
+    if (i >= 0 && i < lib->count) {
+        lib_path(lib, lib->entries[i].name, out, n);
+        ok = 1;
+    }
+    SDL_UnlockMutex(lib->lock);
+    return ok;
+}
+
+// CRC32/SHA-1 do cartucho inserido, se ele está na biblioteca (modal Info)
+static int library_find_hashes(const char* path, Uint32* crc, Uint8 sha1[20]) {
+    Library* lib = &library;
+    size_t n = strlen(lib->dir);
+    if (!lib->lock || strncmp(path, lib->dir, n) != 0 || (path[n] != '/' && path[n] != '\\')) return 0;
+    LibEntry key;
+    snprintf(key.name, sizeof(key.name), "%s", path + n + 1);
+    int found = 0;
+    SDL_LockMutex(lib->lock);
+    const LibEntry* e = lib->count ? (const LibEntry*)bsearch(&key, lib->entries, (size_t)lib->count, sizeof(LibEntry), lib_cmp_entry) : NULL;
+    if (e && e->readable) {
+        *crc = e->crc32;
+        memcpy(sha1, e->sha1, 20);
+        found = 1;
+    }
+    SDL_UnlockMutex(lib->lock);
+    return found;
+}
+
+static void drawLibrary(SDL_Renderer* renderer, GlyphAtlas* atlas, const Modal* m, SDL_Color textColor) {
+    Library* lib = &library;
+    SDL_Color dim = { fcol_to_u8(currentTheme.mutedText.r), fcol_to_u8(currentTheme.mutedText.g), fcol_to_u8(currentTheme.mutedText.b), 255 };
+    char buf[1024]; // cabe o diretório (512) ou o nome (256) inteiros + contadores
+    SDL_LockMutex(lib->lock);
+    // atlas publicado novo: reenviar a textura (uma vez por scan)
+    if (lib->atlas_gen != lib->generation) {
+        if (lib->atlas_tex) SDL_DestroyTexture(lib->atlas_tex);
+        lib->atlas_tex = NULL;
+        if (lib->atlas_rows > 0) {
+            lib->atlas_tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                                               LIB_ATLAS_COLS * 32, lib->atlas_rows * 32);
+            if (lib->atlas_tex) {
+                SDL_UpdateTexture(lib->atlas_tex, NULL, lib->atlas, LIB_ATLAS_COLS * 32 * (int)sizeof(Uint32));
+                SDL_SetTextureBlendMode(lib->atlas_tex, SDL_BLENDMODE_BLEND);
+            } else {
+                SDL_Log("CreateTexture failed: %s", SDL_GetError());
+            }
+        }
+        lib->atlas_gen = lib->generation;
+    }
+
+    int x = m->rect.x + 12, y = m->rect.y + 40;
+    if (SDL_AtomicGet(&lib->running) && SDL_AtomicGet(&lib->scan_total) > 0)
+        snprintf(buf, sizeof(buf), "%s: %d ROM(s), verificando %d/%d", lib->dir, lib->count,
+                 SDL_AtomicGet(&lib->scan_done), SDL_AtomicGet(&lib->scan_total));
+    else
+        snprintf(buf, sizeof(buf), "%s: %d ROM(s)%s", lib->dir, lib->count, SDL_AtomicGet(&lib->running) ? ", procurando..." : "");
+    drawText(renderer, atlas, buf, x, y, dim);
+
+    int rows = library_visible_rows(m);
+    for (int r = 0; r < rows && lib->scroll + r < lib->count; ++r) {
+        const LibEntry* e = &lib->entries[lib->scroll + r];
+        int ry = libraryRowRect(m, r).y;
+        if (e->thumb >= 0 && lib->atlas_tex) {
+            SDL_Rect src = { (e->thumb % LIB_ATLAS_COLS) * 32, (e->thumb / LIB_ATLAS_COLS) * 32, 32, 32 };
+            SDL_Rect dst = { x, ry + (LIB_ROW_H - 32) / 2, 32, 32 };
+            SDL_RenderCopy(renderer, lib->atlas_tex, &src, &dst);
+        }
+        drawText(renderer, atlas, e->title[0] ? e->title : e->name, x + 44, ry + 2, textColor);
+        if (e->readable)
+            snprintf(buf, sizeof(buf), "%s  %.1f MB  CRC32 %08X", e->game_code, (double)e->size / (1024.0 * 1024.0), e->crc32);
+        else
+            snprintf(buf, sizeof(buf), "%s  (ainda não verificado)", e->name);
+        drawText(renderer, atlas, buf, x + 44, ry + 20, dim);
+    }
+    SDL_UnlockMutex(lib->lock);
+}
+
+// -------------------- LZ (compressão de blocos) --------------------
+// Compressor LZ77 no formato de bloco do LZ4 (token 4+4 bits, literais, offset de 16
+// bits, extensões de 255), sem dependência externa. Hash de 4 bytes numa tabela de
+// LZ_HASH_BITS entradas e passo que cresce em trechos sem match: rápido, não ótimo.
+// Blocos independentes de até 64 KB, então cada um pode ser descomprimido em paralelo.
+// O decoder confere todos os limites (arquivo corrompido não escreve fora de dst).
+
+#define LZ_BLOCK_MAX (64 * 1024)
+#define LZ_HASH_BITS 14
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_EXPANSION 255 // bytes de saída por byte comprimido, no pior caso (extensões 255)
+#define LZ_LAST_LITERALS 5   // regra do formato: o bloco termina com literais
+#define LZ_MFLIMIT 12        // último match começa pelo menos 12 bytes antes do fim
+
+// pior caso da saída de lz_compress para n bytes de entrada
+static int lz_bound(int n) { return n + n / 255 + 16; }
+
+static Uint32 lz_read32(const Uint8* p) {
+    Uint32 v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static int lz_hash(Uint32 v) { return (int)((v * 2654435761u) >> (32 - LZ_HASH_BITS)); }
+
+static Uint8* lz_put_len(Uint8* op, size_t len) {
+    for (; len >= 255; len -= 255) *op++ = 255;
+    *op++ = (Uint8)len;
+    return op;
+}
+
+static Uint8* lz_put_sequence(Uint8* op, const Uint8* lit, size_t lit_len, size_t offset, size_t match_len) {
+    Uint8* token = op++;
+    *token = (Uint8)((lit_len < 15 ? lit_len : 15) << 4);
+    if (lit_len >= 15) op = lz_put_len(op, lit_len - 15);
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+    if (offset == 0) return op; // última sequência: só literais
+    *op++ = (Uint8)offset;
+    *op++ = (Uint8)(offset >> 8);
+    size_t m = match_len - LZ_MIN_MATCH;
+    *token |= (Uint8)(m < 15 ? m : 15);
+    if (m >= 15) op = lz_put_len(op, m - 15);
+    return op;
+}
+
+// comprime src[0..n) (n <= LZ_BLOCK_MAX) em dst (lz_bound(n) bytes); retorna o tamanho.
+// table: (1 << LZ_HASH_BITS) posições, reaproveitada entre blocos pelo chamador.
+static int lz_compress(const Uint8* src, int n, Uint8* dst, Uint16* table) {
+    const Uint8* ip = src;
+    const Uint8* anchor = src;
+    const Uint8* end = src + n;
+    Uint8* op = dst;
+    if (n >= LZ_MFLIMIT + 1) {
+        const Uint8* mflimit = end - LZ_MFLIMIT;
+        const Uint8* match_end = end - LZ_LAST_LITERALS;
+        memset(table, 0, sizeof(Uint16) << LZ_HASH_BITS);
+        unsigned misses = 0;
+        ip++;
+        while (ip < mflimit) {
+            Uint32 seq = lz_read32(ip);
+            int h = lz_hash(seq);
+            const Uint8* ref = src + table[h];
+            table[h] = (Uint16)(ip - src);
+            if (ref >= ip || lz_read32(ref) != seq) {
+                ip += 1 + (misses++ >> 5); // dados incompressíveis: pular mais rápido
+                continue;
+            }
+            misses = 0;
+            // estender para trás sobre os literais pendentes e para frente até o limite
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) { ip--; ref--; }
+            const Uint8* mp = ip + LZ_MIN_MATCH;
+            const Uint8* mr = ref + LZ_MIN_MATCH;
+            while (mp < match_end && *mp == *mr) { mp++; mr++; }
+            op = lz_put_sequence(op, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), (size_t)(mp - ip));
+            ip = mp;
+            anchor = ip;
+            if (ip - 2 > src) table[lz_hash(lz_read32(ip - 2))] = (Uint16)(ip - 2 - src);
+        }
+    }
+    op = lz_put_sequence(op, anchor, (size_t)(end - anchor), 0, 0);
+    return (int)(op - dst);
+}
+
+// descomprime exatamente out_n bytes; -1 se o bloco é inválido
+static int lz_decompress(const Uint8* src, int n, Uint8* dst, int out_n) {
+    const Uint8* ip = src;
+    const Uint8* iend = src + n;
+    Uint8* op = dst;
+    Uint8* oend = dst + out_n;
+    while (ip < iend) {
+        unsigned token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15) {
+            Uint8 b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if ((size_t)(iend - ip) < lit || (size_t)(oend - op) < lit) return -1;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip == iend) break;
+        if (iend - ip < 2) return -1;
+        size_t offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return -1;
+        size_t len = token & 15;
+        if (len == 15) {
+            Uint8 b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        len += LZ_MIN_MATCH;
+        if ((size_t)(oend - op) < len) return -1;
+        const Uint8* ref = op - offset;
+        if (offset >= len) memcpy(op, ref, len);
+        else for (size_t i = 0; i < len; ++i) op[i] = ref[i]; // sobreposto (repetição)
+        op += len;
+    }
+    return op == oend ? out_n : -1;
+}
+
+// -------------------- save states --------------------
+// Sistema -> Salvar/Carregar Estado. Arquivo binário versionado e dividido em chunks:
+// cabeçalho (magic, versão do formato, número de chunks) e, para cada subsistema, um
+// chunk {id, versão, tamanho} com os bytes copiados direto do layout em memória, sem
+// conversão para texto. Dados alinhados em STATE_ALIGN para o load ler do mapeamento.
+// Salvar só copia os chunks (alguns KB) no main thread; a thread de gravação renderiza
+// o SCRN (fundo naquele estado) e faz fwrite + fsync + rename. Carregar mapeia o
+// arquivo, valida todos os chunks e copia do mapeamento direto para os globais; o
+// SCRN vai do mapeamento para a textura de fundo. Chunk de id ou versão desconhecidos
+// é ignorado (com log), então arquivos de versões futuras ainda carregam o que der.
+// Formato 2: cada chunk vira blocos LZ de até 64 KB ({tamanho, bytes}; bloco que não
+// comprime fica cru). A thread de gravação comprime em streaming, bloco a bloco, direto
+// para o arquivo; o load descomprime todos os blocos em paralelo do mapeamento para o
+// buffer que state_restore lê. Arquivos do formato 1 continuam carregando sem cópia.
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#endif
+
+#define STATE_MAGIC "NDSSTATE"
+#define STATE_FORMAT_VERSION 2  // 1: chunks crus; 2: chunks em blocos LZ
+#define STATE_ALIGN 16
+#define STATE_DIR "states"
+#define STATE_MAX_PIECES 6
+
+typedef struct {
+    char magic[8];
+    Uint32 version;
+    Uint32 chunk_count;
+    Uint64 ticks;             // tick da simulação no momento do save
+    Uint8 reserved[8];
+} StateFileHeader;
+
+typedef struct {
+    char id[4];
+    Uint32 version;           // versão do layout deste chunk
+    Uint64 size;              // bytes de dados (sem o padding até STATE_ALIGN)
+} StateChunkHeader;
+
+typedef struct {
+    void* ptr;
+    size_t size;
+} StatePiece;
+
+// um chunk = pedaços contíguos em memória, gravados em sequência
+typedef struct {
+    char id[4];
+    Uint32 version;
+    int count;
+    StatePiece pieces[STATE_MAX_PIECES];
+} StateChunkDesc;
+
+typedef struct {
+    Uint32 w, h;
+} StateScreenHeader;
+
+#define STATE_BLOCK LZ_BLOCK_MAX
+#define STATE_BLOCK_RAW 0x80000000u   // bloco guardado sem compressão
+#define STATE_CODEC_LZ 1
+#define STATE_FILTER_DELTA4 1         // delta com o byte 4 posições antes (pixels ARGB)
+
+// chunk no arquivo do formato 2: dados = blocos {Uint32 tamanho | STATE_BLOCK_RAW, bytes}
+typedef struct {
+    char id[4];
+    Uint32 version;
+    Uint64 size;              // bytes descomprimidos
+    Uint32 codec;
+    Uint32 filter;
+    Uint64 stored;            // bytes no arquivo, sem o padding
+} StateFileChunk;
+
+#define STATE_CHUNK_COUNT 4
+
+// chunks de cada subsistema; cart_path aponta para onde o CART é lido/escrito
+static int state_chunks(SimClock* sc, char* cart_path, StateChunkDesc d[STATE_CHUNK_COUNT]) {
+    d[0] = (StateChunkDesc){ {'C','L','C','K'}, 1, 2, {
+        { &sc->ticks, sizeof(sc->ticks) }, { &sc->accumulator, sizeof(sc->accumulator) } } };
+    d[1] = (StateChunkDesc){ {'A','N','I','M'}, 1, 2, {
+        { colorAnims, sizeof(colorAnims) }, { colorAnimsPrev, sizeof(colorAnimsPrev) } } };
+    d[2] = (StateChunkDesc){ {'T','H','E','M'}, 1, 6, {
+        { &startTheme, sizeof(startTheme) }, { &targetTheme, sizeof(targetTheme) }, { &currentTheme, sizeof(currentTheme) },
+        { &theme_t, sizeof(theme_t) }, { &theme_t_prev, sizeof(theme_t_prev) }, { &theme_duration, sizeof(theme_duration) } } };
+    d[3] = (StateChunkDesc){ {'C','A','R','T'}, 1, 1, { { cart_path, sizeof(cart.path) } } };
+    return STATE_CHUNK_COUNT;
+}
+
+static size_t state_align(size_t n) { return (n + STATE_ALIGN - 1) & ~(size_t)(STATE_ALIGN - 1); }
+
+static size_t state_chunk_size(const StateChunkDesc* d) {
+    size_t n = 0;
+    for (int i = 0; i < d->count; ++i) n += d->pieces[i].size;
+    return n;
+}
+
+// bytes de state_capture() (fixo para um build)
+static size_t state_capture_size(SimClock* sc) {
+    StateChunkDesc d[STATE_CHUNK_COUNT];
+    int n = state_chunks(sc, cart.path, d);
+    size_t total = 0;
+    for (int i = 0; i < n; ++i) total += sizeof(StateChunkHeader) + state_align(state_chunk_size(&d[i]));
+    return total;
+}
+
+// copia os chunks do estado atual para dst (state_capture_size bytes); retorna os bytes escritos
+static size_t state_capture(Uint8* dst, size_t cap, SimClock* sc) {
+    StateChunkDesc d[STATE_CHUNK_COUNT];
+    int n = state_chunks(sc, cart.path, d);
+    size_t o = 0;
+    for (int i = 0; i < n; ++i) {
+        size_t size = state_chunk_size(&d[i]);
+        size_t padded = state_align(size);
+        if (o + sizeof(StateChunkHeader) + padded > cap) return 0;
+        StateChunkHeader h;
+        memcpy(h.id, d[i].id, 4);
+        h.version = d[i].version;
+        h.size = size;
+        memcpy(dst + o, &h, sizeof(h));
+        o += sizeof(h);
+        for (int p = 0; p < d[i].count; ++p) {
+            memcpy(dst + o, d[i].pieces[p].ptr, d[i].pieces[p].size);
+            o += d[i].pieces[p].size;
+        }
+        memset(dst + o, 0, padded - size);
+        o += padded - size;
+    }
+    return o;
+}
+
+// percorre os chunks de 'data'; 0 se algum sai dos limites (arquivo truncado/corrompido)
+static int state_validate(const Uint8* data, size_t size, int* count) {
+    size_t o = 0;
+    int n = 0;
+    while (o < size) {
+        StateChunkHeader h;
+        if (size - o < sizeof(h)) return 0;
+        memcpy(&h, data + o, sizeof(h));
+        o += sizeof(h);
+        if (h.size > size - o || state_align((size_t)h.size) > size - o) return 0;
+        o += state_align((size_t)h.size);
+        n++;
+    }
+    if (count) *count = n;
+    return 1;
+}
+
+// dados do chunk 'id' em 'data' (já validado); NULL se não existe
+static const Uint8* state_find_chunk(const Uint8* data, size_t size, const char id[4], StateChunkHeader* out) {
+    size_t o = 0;
+    while (o + sizeof(StateChunkHeader) <= size) {
+        memcpy(out, data + o, sizeof(*out));
+        o += sizeof(*out);
+        if (memcmp(out->id, id, 4) == 0) return data + o;
+        o += state_align((size_t)out->size);
+    }
+    return NULL;
+}
+
+#define STATE_RESTORE_CART 1    // trocar de cartucho se o estado foi salvo com outro
+#define STATE_RESTORE_RESYNC 2  // salto na linha do tempo: relógio e keyframes recomeçam
+
+// aplica os chunks de 'data' (saída de state_capture ou corpo do arquivo) ao estado atual.
+// Tudo é validado antes de mexer em qualquer global.
+static int state_restore(const Uint8* data, size_t size, SimClock* sc, int flags) {
+    int count = 0;
+    if (!state_validate(data, size, &count)) {
+        SDL_Log("Estado inválido (chunks fora dos limites)");
+        return 0;
+    }
+    char cart_path[sizeof(cart.path)];
+    StateChunkDesc d[STATE_CHUNK_COUNT];
+    int n = state_chunks(sc, cart_path, d);
+    const Uint8* src[STATE_CHUNK_COUNT] = {0};
+    for (int i = 0; i < n; ++i) {
+        StateChunkHeader h;
+        src[i] = state_find_chunk(data, size, d[i].id, &h);
+        if (src[i] && (h.version != d[i].version || h.size != state_chunk_size(&d[i]))) {
+            SDL_Log("Estado: chunk %.4s v%u (%llu bytes) não é compatível com v%u, ignorado",
+                    d[i].id, h.version, (unsigned long long)h.size, d[i].version);
+            src[i] = NULL;
+        }
+    }
+    // ids que este build não conhece (SCRN é lido por state_load): só o log
+    for (size_t o = 0; o < size;) {
+        StateChunkHeader h;
+        memcpy(&h, data + o, sizeof(h));
+        o += sizeof(h) + state_align((size_t)h.size);
+        int known = memcmp(h.id, "SCRN", 4) == 0;
+        for (int i = 0; i < n && !known; ++i) known = memcmp(h.id, d[i].id, 4) == 0;
+        if (!known) SDL_Log("Estado: chunk %.4s desconhecido, ignorado", h.id);
+    }
+    // THEM: início/fim da transição (as duas primeiras peças) diferentes = outro tema
+    int theme_changed = src[2] && (memcmp(src[2], d[2].pieces[0].ptr, d[2].pieces[0].size) != 0 ||
+                                   memcmp(src[2] + d[2].pieces[0].size, d[2].pieces[1].ptr, d[2].pieces[1].size) != 0);
+    for (int i = 0; i < n; ++i) {
+        if (!src[i]) continue;
+        const Uint8* p = src[i];
+        for (int k = 0; k < d[i].count; ++k) {
+            memcpy(d[i].pieces[k].ptr, p, d[i].pieces[k].size);
+            p += d[i].pieces[k].size;
+        }
+    }
+    if (src[2]) {
+        // nomes vêm do arquivo: baker e state_save fazem "%s" neles
+        startTheme.name[sizeof(startTheme.name) - 1] = '\0';
+        targetTheme.name[sizeof(targetTheme.name) - 1] = '\0';
+        currentTheme.name[sizeof(currentTheme.name) - 1] = '\0';
+    }
+    if (flags & STATE_RESTORE_RESYNC) {
+        // o relógio continua do tick salvo; o acumulador não conta o tempo até aqui
+        sc->last = SDL_GetPerformanceCounter();
+        sim_timeline++; // keyframes simulados a partir da linha do tempo anterior
+        if (theme_changed) theme_generation++; // caches de cor do tema anterior
+    }
+    if (src[3] && (flags & STATE_RESTORE_CART)) {
+        cart_path[sizeof(cart_path) - 1] = '\0';
+        if (cart_path[0] && strcmp(cart_path, cart.path) != 0) cart_insert(&cart, cart_path);
+        else if (!cart_path[0] && cart.data) SDL_Log("Estado salvo sem cartucho; mantendo %s", cart.path);
+    }
+    return 1;
+}
+
+// gravação em segundo plano: no máximo um pedido esperando (um novo substitui o antigo)
+typedef struct {
+    char path[1024];
+    Uint8* body;              // chunks de state_capture
+    size_t body_size;
+    int body_chunks;
+    Uint64 ticks;
+    // para renderizar o SCRN fora do main thread
+    ColorAnim anims[NUM_COLOR_ANIMS];
+    char theme_name[64];
+    float accent[3], intensity, gain;
+    int w, h;
+} StateJob;
+
+typedef struct {
+    SDL_Thread* thread;
+    SDL_mutex* lock;
+    SDL_cond* cond;
+    int quit;
+    int busy;
+    StateJob* pending;
+    int saved;                // arquivos gravados (HUD/log)
+    WorkerPool* decode_pool;  // criado no primeiro load comprimido
+} StateWriter;
+
+static StateWriter stateWriter = {0};
+
+static void state_job_free(StateJob* job) {
+    if (!job) return;
+    free(job->body);
+    free(job);
+}
+
+// escrita de um arquivo do formato 2, chunk a chunk
+typedef struct {
+    FILE* f;
+    int ok;
+    Uint8* scratch;           // bloco filtrado
+    Uint8* out;               // lz_bound(STATE_BLOCK)
+    Uint16* table;
+    Uint64 raw_total, stored_total;
+} StateStream;
+
+static void state_stream_write(StateStream* s, const void* p, size_t n) {
+    if (s->ok && n && fwrite(p, 1, n, s->f) != n) s->ok = 0;
+}
+
+// pixels vizinhos são parecidos: a diferença byte a byte vira quase só zeros
+static void state_delta4_encode(const Uint8* src, Uint8* dst, int n) {
+    for (int i = 0; i < n && i < 4; ++i) dst[i] = src[i];
+    for (int i = 4; i < n; ++i) dst[i] = (Uint8)(src[i] - src[i - 4]);
+}
+
+static void state_delta4_decode(Uint8* p, int n) {
+    for (int i = 4; i < n; ++i) p[i] = (Uint8)(p[i] + p[i - 4]);
+}
+
+// cabeçalho, blocos comprimidos à medida que saem e padding; 'stored' só é conhecido no
+// fim, então o cabeçalho é reescrito com um seek
+static void state_stream_chunk(StateStream* s, const char id[4], Uint32 version, const Uint8* data, size_t size, Uint32 filter) {
+    static const Uint8 zeros[STATE_ALIGN] = {0};
+    StateFileChunk c;
+    memset(&c, 0, sizeof(c));
+    memcpy(c.id, id, 4);
+    c.version = version;
+    c.size = size;
+    c.codec = STATE_CODEC_LZ;
+    c.filter = filter;
+    long at = ftell(s->f);
+    state_stream_write(s, &c, sizeof(c));
+    for (size_t off = 0; off < size && s->ok; off += STATE_BLOCK) {
+        int n = (int)(size - off < STATE_BLOCK ? size - off : STATE_BLOCK);
+        const Uint8* src = data + off;
+        if (filter == STATE_FILTER_DELTA4) {
+            state_delta4_encode(src, s->scratch, n);
+            src = s->scratch;
+        }
+        int packed = lz_compress(src, n, s->out, s->table);
+        Uint32 word = packed < n ? (Uint32)packed : ((Uint32)n | STATE_BLOCK_RAW);
+        state_stream_write(s, &word, sizeof(word));
+        state_stream_write(s, packed < n ? s->out : src, (size_t)(packed < n ? packed : n));
+        c.stored += sizeof(word) + (Uint64)(packed < n ? packed : n);
+    }
+    state_stream_write(s, zeros, state_align((size_t)c.stored) - (size_t)c.stored);
+    long end = ftell(s->f);
+    if (s->ok && (at < 0 || end < 0 || fseek(s->f, at, SEEK_SET) != 0)) s->ok = 0;
+    state_stream_write(s, &c, sizeof(c));
+    if (s->ok && fseek(s->f, end, SEEK_SET) != 0) s->ok = 0;
+    s->raw_total += size;
+    s->stored_total += c.stored;
+}
+
+static void state_job_run(StateJob* job) {
+    Uint64 t0 = SDL_GetPerformanceCounter();
+    // SCRN: o fundo naquele estado, renderizado aqui com o mesmo kernel do sweep
+    StateScreenHeader sh = { (Uint32)job->w, (Uint32)job->h };
+    size_t px_bytes = (size_t)job->w * job->h * sizeof(Uint32);
+    Uint8* scrn = (Uint8*)malloc(sizeof(sh) + px_bytes);
+    size_t scrn_size = 0;
+    if (scrn) {
+        SweepTables tabs = {0};
+        SweepParams params;
+        float col[NUM_COLOR_ANIMS][3], animR[3], animG[3], animB[3];
+        for (int i = 0; i < NUM_COLOR_ANIMS; ++i) get_anim_color(&job->anims[i], col[i]);
+        idle_anim_remap(job->theme_name, col, animR, animG, animB);
+        if (sweep_params_build(&params, &tabs, job->w, job->h, animR, animG, animB, job->accent, job->intensity, job->gain)) {
+            memcpy(scrn, &sh, sizeof(sh));
+            sweep_rows(&params, (Uint32*)(scrn + sizeof(sh)), job->w, 0, job->h);
+            scrn_size = sizeof(sh) + px_bytes;
+        }
+        sweep_tables_free(&tabs);
+    }
+
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", job->path);
+    StateStream st = {0};
+    st.f = fopen(tmp, "wb");
+    st.scratch = (Uint8*)malloc(STATE_BLOCK);
+    st.out = (Uint8*)malloc((size_t)lz_bound(STATE_BLOCK));
+    st.table = (Uint16*)malloc(sizeof(Uint16) << LZ_HASH_BITS);
+    st.ok = st.f && st.scratch && st.out && st.table;
+    if (!st.f) SDL_Log("Estado: não foi possível gravar %s", tmp);
+
+    StateFileHeader fh;
+    memset(&fh, 0, sizeof(fh));
+    memcpy(fh.magic, STATE_MAGIC, 8);
+    fh.version = STATE_FORMAT_VERSION;
+    fh.chunk_count = (Uint32)job->body_chunks + (scrn_size ? 1 : 0);
+    fh.ticks = job->ticks;
+    state_stream_write(&st, &fh, sizeof(fh));
+    // chunks capturados no main thread: mesmo id/versão, dados comprimidos
+    for (size_t o = 0; o + sizeof(StateChunkHeader) <= job->body_size && st.ok;) {
+        StateChunkHeader h;
+        memcpy(&h, job->body + o, sizeof(h));
+        o += sizeof(h);
+        state_stream_chunk(&st, h.id, h.version, job->body + o, (size_t)h.size, 0);
+        o += state_align((size_t)h.size);
+    }
+    if (scrn_size) state_stream_chunk(&st, "SCRN", 1, scrn, scrn_size, STATE_FILTER_DELTA4);
+
+    int ok = st.ok && fflush(st.f) == 0;
+    if (st.f) {
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(st.f)) == 0;
+#else
+        ok = ok && fsync(fileno(st.f)) == 0;
+#endif
+        ok = fclose(st.f) == 0 && ok;
+    }
+#ifdef _WIN32
+    if (ok) remove(job->path); // rename do Windows não substitui
+#endif
+    if (ok && rename(tmp, job->path) == 0) {
+        SDL_Log("Estado salvo: %s (%.1f KB -> %.1f KB, %.1f ms em segundo plano)", job->path,
+                (double)st.raw_total / 1024.0, (double)st.stored_total / 1024.0,
+                (double)(SDL_GetPerformanceCounter() - t0) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+    } else {
+        if (st.f) remove(tmp);
+        SDL_Log("Estado: falha ao gravar %s", job->path);
+    }
+    free(st.scratch);
+    free(st.out);
+    free(st.table);
+    free(scrn);
+}
+
+static int state_writer_main(void* arg) {
+    StateWriter* w = (StateWriter*)arg;
+    SDL_LockMutex(w->lock);
+    for (;;) {
+        // sair só depois de gravar o que foi pedido (Salvar logo antes de fechar)
+        if (!w->pending) {
+            if (w->quit) break;
+            SDL_CondWait(w->cond, w->lock);
+            continue;
+        }
+        StateJob* job = w->pending;
+        w->pending = NULL;
+        w->busy = 1;
+        SDL_UnlockMutex(w->lock);
+        PROF_BEGIN(pz);
+        state_job_run(job);
+        PROF_END(pz, "state write");
+        state_job_free(job);
+        SDL_LockMutex(w->lock);
+        w->busy = 0;
+        w->saved++;
+        SDL_CondBroadcast(w->cond);
+    }
+    SDL_UnlockMutex(w->lock);
+    return 0;
+}
+
+static int state_writer_init(StateWriter* w) {
+    memset(w, 0, sizeof(*w));
+    w->lock = SDL_CreateMutex();
+    w->cond = SDL_CreateCond();
+    if (w->lock && w->cond) w->thread = SDL_CreateThread(state_writer_main, "state-writer", w);
+    if (!w->thread) SDL_Log("Falha ao criar a thread de save state: %s", SDL_GetError());
+    return w->thread != NULL;
+}
+
+// espera a gravação pendente (load do mesmo arquivo logo depois de salvar)
+static void state_writer_flush(StateWriter* w) {
+    if (!w->thread) return;
+    SDL_LockMutex(w->lock);
+    while (w->pending || w->busy) SDL_CondWait(w->cond, w->lock);
+    SDL_UnlockMutex(w->lock);
+}
+
+static void state_writer_destroy(StateWriter* w) {
+    if (w->thread) {
+        SDL_LockMutex(w->lock);
+        w->quit = 1;
+        SDL_CondBroadcast(w->cond);
+        SDL_UnlockMutex(w->lock);
+        SDL_WaitThread(w->thread, NULL);
+    }
+    state_job_free(w->pending);
+    pool_destroy(w->decode_pool);
+    if (w->cond) SDL_DestroyCond(w->cond);
+    if (w->lock) SDL_DestroyMutex(w->lock);
+    memset(w, 0, sizeof(*w));
+}
+
+// states/<código do jogo ou "idle">.s<slot>
+static void state_path(int slot, char* out, size_t n) {
+    const char* name = cart.data && cart_header(&cart) && cart.game_code[0] ? cart.game_code : "idle";
+    snprintf(out, n, "%s/%s.s%02d", STATE_DIR, name, slot);
+}
+
+// Salvar Estado: copia os chunks agora e entrega a gravação à thread
+static int state_save(StateWriter* w, SimClock* sc, int slot) {
+    PROF_BEGIN(pz);
+    StateJob* job = (StateJob*)calloc(1, sizeof(StateJob));
+    size_t cap = state_capture_size(sc);
+    if (job) job->body = (Uint8*)malloc(cap);
+    if (!job || !job->body) {
+        SDL_Log("malloc failed for save state (%zu bytes)", cap);
+        state_job_free(job);
+        return 0;
+    }
+    job->body_size = state_capture(job->body, cap, sc);
+    job->body_chunks = STATE_CHUNK_COUNT;
+    job->ticks = sc->ticks;
+    memcpy(job->anims, colorAnims, sizeof(job->anims));
+    snprintf(job->theme_name, sizeof(job->theme_name), "%s", currentTheme.name);
+    job->accent[0] = currentTheme.accent.r;
+    job->accent[1] = currentTheme.accent.g;
+    job->accent[2] = currentTheme.accent.b;
+    job->intensity = currentTheme.idle_intensity;
+    job->gain = currentTheme.idle_gain;
+    job->w = bg_w;
+    job->h = bg_h;
+    state_path(slot, job->path, sizeof(job->path));
+#ifdef _WIN32
+    _mkdir(STATE_DIR);
+#else
+    mkdir(STATE_DIR, 0755);
+#endif
+    PROF_END(pz, "state capture");
+
+    if (!w->thread) {
+        // sem thread: gravar aqui mesmo
+        state_job_run(job);
+        state_job_free(job);
+        return 1;
+    }
+    SDL_LockMutex(w->lock);
+    state_job_free(w->pending); // pedido anterior ainda não começou: o novo vale
+    w->pending = job;
+    SDL_CondSignal(w->cond);
+    SDL_UnlockMutex(w->lock);
+    return 1;
+}
+
+typedef struct {
+    const Uint8* src;
+    Uint32 src_len;
+    int raw;
+    Uint8* dst;
+    Uint32 dst_len;
+    Uint32 filter;
+} StateBlock;
+
+typedef struct {
+    StateBlock* blocks;
+    SDL_atomic_t failed;
+} StateDecodeJob;
+
+static void state_decode_block(void* ctx, int index) {
+    StateDecodeJob* job = (StateDecodeJob*)ctx;
+    const StateBlock* b = &job->blocks[index];
+    if (b->raw) memcpy(b->dst, b->src, b->dst_len);
+    else if (lz_decompress(b->src, (int)b->src_len, b->dst, (int)b->dst_len) < 0) {
+        SDL_AtomicSet(&job->failed, 1);
+        return;
+    }
+    if (b->filter == STATE_FILTER_DELTA4) state_delta4_decode(b->dst, (int)b->dst_len);
+}
+
+// corpo do formato 2 -> chunks no layout de state_capture (o que state_restore lê).
+// Os blocos saem do mapeamento direto para o destino, em paralelo. NULL = corrompido.
+static Uint8* state_decode_body(StateWriter* w, const Uint8* data, size_t size, size_t* out_size) {
+    // 1) validar os chunks e contar blocos e bytes de saída
+    size_t o = 0, plain = 0;
+    int nblocks = 0;
+    while (o < size) {
+        StateFileChunk c;
+        if (size - o < sizeof(c)) return NULL;
+        memcpy(&c, data + o, sizeof(c));
+        o += sizeof(c);
+        if (c.stored > size - o || state_align((size_t)c.stored) > size - o || c.size > ((Uint64)1 << 32)) return NULL;
+        if (c.codec == STATE_CODEC_LZ) {
+            Uint64 blocks = (c.size + STATE_BLOCK - 1) / STATE_BLOCK;
+            // cada bloco tem ao menos a palavra de tamanho: arquivo pequeno não pede GBs de saída
+            if (c.stored < blocks * sizeof(Uint32)) return NULL;
+            // e rende no máximo src_len (cru) ou LZ_MAX_EXPANSION * src_len: c.size acima da
+            // soma é arquivo forjado, recusado antes do calloc
+            const Uint8* p = data + o;
+            const Uint8* pend = p + c.stored;
+            Uint64 limit = 0;
+            for (Uint64 b = 0; b < blocks; ++b) {
+                Uint32 word;
+                if (pend - p < (ptrdiff_t)sizeof(word)) return NULL;
+                memcpy(&word, p, sizeof(word));
+                p += sizeof(word);
+                Uint32 src_len = word & ~STATE_BLOCK_RAW;
+                if ((Uint64)(pend - p) < src_len) return NULL;
+                p += src_len;
+                limit += (word & STATE_BLOCK_RAW) ? src_len : (Uint64)src_len * LZ_MAX_EXPANSION;
+            }
+            if (limit < c.size) return NULL;
+            nblocks += (int)blocks;
+            plain += sizeof(StateChunkHeader) + state_align((size_t)c.size);
+        } else {
+            SDL_Log("Estado: chunk %.4s com codec %u desconhecido, ignorado", c.id, c.codec);
+        }
+        o += state_align((size_t)c.stored);
+    }
+    Uint8* out = (Uint8*)calloc(plain ? plain : 1, 1);
+    StateDecodeJob job = { nblocks ? (StateBlock*)malloc(sizeof(StateBlock) * (size_t)nblocks) : NULL, {0} };
+    if (!out || (nblocks && !job.blocks)) {
+        SDL_Log("malloc failed for save state (%zu bytes)", plain);
+        free(out);
+        free(job.blocks);
+        return NULL;
+    }
+    // 2) cabeçalhos de saída e descrição de cada bloco
+    size_t d = 0;
+    int k = 0, ok = 1;
+    for (o = 0; o < size && ok;) {
+        StateFileChunk c;
+        memcpy(&c, data + o, sizeof(c));
+        o += sizeof(c);
+        if (c.codec == STATE_CODEC_LZ) {
+            StateChunkHeader h;
+            memcpy(h.id, c.id, 4);
+            h.version = c.version;
+            h.size = c.size;
+            memcpy(out + d, &h, sizeof(h));
+            d += sizeof(h);
+            const Uint8* p = data + o;
+            const Uint8* pend = p + c.stored;
+            for (Uint64 off = 0; off < c.size && ok; off += STATE_BLOCK) {
+                Uint32 word;
+                if (pend - p < (ptrdiff_t)sizeof(word)) { ok = 0; break; }
+                memcpy(&word, p, sizeof(word));
+                p += sizeof(word);
+                StateBlock* b = &job.blocks[k++];
+                b->raw = (word & STATE_BLOCK_RAW) != 0;
+                b->src_len = word & ~STATE_BLOCK_RAW;
+                b->src = p;
+                b->dst = out + d + off;
+                b->dst_len = (Uint32)(c.size - off < STATE_BLOCK ? c.size - off : STATE_BLOCK);
+                b->filter = c.filter;
+                if ((Uint64)(pend - p) < b->src_len || (b->raw && b->src_len != b->dst_len)) ok = 0;
+                p += b->src_len;
+            }
+            if (p != pend) ok = 0;
+            d += state_align((size_t)c.size);
+        }
+        o += state_align((size_t)c.stored);
+    }
+    // 3) descomprimir; blocos são independentes
+    if (ok && nblocks > 1 && !w->decode_pool) {
+        int threads = SDL_GetCPUCount() / 2;
+        w->decode_pool = pool_create(threads < 1 ? 1 : threads);
+    }
+    if (ok && nblocks > 1 && w->decode_pool) {
+        pool_submit(w->decode_pool, state_decode_block, &job, nblocks);
+        pool_wait(w->decode_pool);
+    } else if (ok) {
+        for (int i = 0; i < nblocks; ++i) state_decode_block(&job, i);
+    }
+    free(job.blocks);
+    if (!ok || SDL_AtomicGet(&job.failed)) {
+        free(out);
+        return NULL;
+    }
+    *out_size = plain;
+    return out;
+}
+
+// Carregar Estado: mapeia o arquivo e restaura direto do mapeamento (formato 1) ou do
+// resultado da descompressão paralela (formato 2)
+static int state_load(StateWriter* w, SimClock* sc, int slot) {
+    char path[1024];
+    state_path(slot, path, sizeof(path));
+    state_writer_flush(w);
+    PROF_BEGIN(pz);
+    MappedFile m;
+    if (!file_map(&m, path, sizeof(StateFileHeader), (size_t)-1)) return 0;
+    StateFileHeader fh;
+    memcpy(&fh, m.data, sizeof(fh));
+    if (memcmp(fh.magic, STATE_MAGIC, 8) != 0 || fh.version == 0 || fh.version > STATE_FORMAT_VERSION) {
+        SDL_Log("Estado: %s não é um save state compatível (versão %u)", path, fh.version);
+        file_unmap(&m);
+        return 0;
+    }
+    const Uint8* body = m.data + sizeof(fh);
+    size_t body_size = m.size - sizeof(fh);
+    Uint8* decoded = NULL;
+    if (fh.version >= 2) {
+        decoded = state_decode_body(w, body, body_size, &body_size);
+        if (!decoded) {
+            SDL_Log("Estado: %s está corrompido", path);
+            file_unmap(&m);
+            return 0;
+        }
+        body = decoded;
+    }
+    int ok = state_restore(body, body_size, sc, STATE_RESTORE_CART | STATE_RESTORE_RESYNC);
+    // SCRN: do corpo (mapeamento ou blocos descomprimidos) para a textura de fundo já apresentada
+    StateChunkHeader ch;
+    const Uint8* scrn = ok ? state_find_chunk(body, body_size, "SCRN", &ch) : NULL;
+    if (scrn && ch.version == 1 && ch.size >= sizeof(StateScreenHeader) && bgReadyIndex >= 0) {
+        StateScreenHeader sh;
+        memcpy(&sh, scrn, sizeof(sh));
+        if ((int)sh.w == bg_w && (int)sh.h == bg_h && ch.size == sizeof(sh) + (Uint64)sh.w * sh.h * sizeof(Uint32))
+            SDL_UpdateTexture(bgTextures[bgReadyIndex], NULL, scrn + sizeof(sh), bg_w * (int)sizeof(Uint32));
+    }
+    free(decoded);
+    file_unmap(&m);
+    PROF_END(pz, "state load");
+    if (ok) SDL_Log("Estado carregado: %s (tick %llu)", path, (unsigned long long)fh.ticks);
+    return ok;
+}
+
+// -------------------- rewind --------------------
+// Sistema -> Rebobinar: a cada REWIND_EVERY passos de simulação o estado (os mesmos
+// chunks do save state, sem SCRN) vai para uma fila; uma thread faz XOR com o snapshot
+// anterior e comprime os zeros com RLE num ring de bytes de REWIND_BUDGET. No main
+// thread o custo é só a cópia dos chunks (~2 KB). Segurar Backspace volta um snapshot
+// por frame: o delta mais novo aplicado sobre o snapshot mais novo dá o anterior. Com o
+// ring cheio os deltas mais antigos são descartados.
+
+#define REWIND_EVERY 4                      // passos de simulação entre snapshots (30/s)
+#define REWIND_BUDGET ((size_t)256 * 1024 * 1024)
+#define REWIND_MAX_ENTRIES (1 << 20)        // ~9.7 h a 30 snapshots/s
+#define REWIND_QUEUE 8                      // snapshots esperando a thread
+
+typedef struct {
+    size_t offset;
+    Uint32 size;
+} RewindEntry;
+
+typedef struct {
+    SDL_Thread* thread;
+    SDL_mutex* lock;
+    SDL_cond* cond;
+    int quit;
+    int busy;
+    int enabled;
+    int rewinding;            // Backspace segurado (main thread)
+    size_t snap_size;
+    // fila main -> thread: snapshots completos
+    Uint8* queue;             // REWIND_QUEUE * snap_size
+    int q_head, q_count;
+    // ring de deltas (sob lock)
+    Uint8* ring;              // REWIND_BUDGET
+    size_t write;
+    size_t bytes;             // soma dos deltas guardados
+    RewindEntry* entries;     // circular, mais antigo em e_head
+    int e_head, e_count;
+    Uint8* last;              // snapshot mais novo (base do próximo delta)
+    int has_last;
+    Uint8* delta;             // XOR (thread)
+    Uint8* enc;               // RLE (thread), pior caso
+    Uint64 last_tick;
+    int dropped;              // fila cheia
+    float capture_us;         // último capture no main thread (HUD)
+} RewindRing;
+
+static RewindRing rewindRing = {0};
+
+static Uint8* rewind_put_varint(Uint8* op, size_t v) {
+    for (; v >= 0x80; v >>= 7) *op++ = (Uint8)(v | 0x80);
+    *op++ = (Uint8)v;
+    return op;
+}
+
+static int rewind_get_varint(const Uint8** ip, const Uint8* end, size_t* v) {
+    size_t r = 0;
+    for (int shift = 0; *ip < end && shift < 64; shift += 7) {
+        Uint8 b = *(*ip)++;
+        r |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) { *v = r; return 1; }
+    }
+    return 0;
+}
+
+// pior caso do RLE de n bytes
+static size_t rewind_rle_bound(size_t n) { return n + n / 2 + 16; }
+
+// pares {zeros pulados, literais} em varint; um zero isolado fica dentro dos literais
+static size_t rewind_rle_encode(const Uint8* x, size_t n, Uint8* out) {
+    Uint8* op = out;
+    size_t i = 0;
+    while (i < n) {
+        size_t z = i;
+        while (i < n && x[i] == 0) i++;
+        size_t lit = i;
+        while (i < n && (x[i] != 0 || (i + 1 < n && x[i + 1] != 0))) i++;
+        op = rewind_put_varint(op, lit - z);
+        op = rewind_put_varint(op, i - lit);
+        memcpy(op, x + lit, i - lit);
+        op += i - lit;
+    }
+    return (size_t)(op - out);
+}
+
+// dst ^= delta codificado; 0 se o delta não cabe em dst
+static int rewind_rle_xor(const Uint8* in, size_t n, Uint8* dst, size_t dst_n) {
+    const Uint8* ip = in;
+    const Uint8* end = in + n;
+    size_t o = 0;
+    while (ip < end) {
+        size_t z, lit;
+        if (!rewind_get_varint(&ip, end, &z) || !rewind_get_varint(&ip, end, &lit)) return 0;
+        if (z > dst_n - o || lit > dst_n - o - z || lit > (size_t)(end - ip)) return 0;
+        o += z;
+        for (size_t k = 0; k < lit; ++k) dst[o + k] ^= ip[k];
+        o += lit;
+        ip += lit;
+    }
+    return 1;
+}
+
+// descarta o delta mais antigo (chamada com lock)
+static void rewind_evict_oldest(RewindRing* r) {
+    r->bytes -= r->entries[r->e_head].size;
+    r->e_head = (r->e_head + 1) % REWIND_MAX_ENTRIES;
+    r->e_count--;
+}
+
+// guarda 'n' bytes no ring, liberando os deltas mais antigos que ocupam o espaço (com lock)
+static void rewind_push(RewindRing* r, const Uint8* data, size_t n) {
+    if (n > REWIND_BUDGET) return;
+    if (r->write + n > REWIND_BUDGET) {
+        // volta ao início: os deltas depois de 'write' são os mais antigos
+        while (r->e_count > 0 && r->entries[r->e_head].offset >= r->write) rewind_evict_oldest(r);
+        r->write = 0;
+    }
+    while (r->e_count > 0) {
+        const RewindEntry* old = &r->entries[r->e_head];
+        int overlaps = old->offset < r->write + n && old->offset + old->size > r->write;
+        if (!overlaps && r->e_count < REWIND_MAX_ENTRIES) break;
+        rewind_evict_oldest(r);
+    }
+    memcpy(r->ring + r->write, data, n);
+    RewindEntry* e = &r->entries[(r->e_head + r->e_count) % REWIND_MAX_ENTRIES];
+    e->offset = r->write;
+    e->size = (Uint32)n;
+    r->e_count++;
+    r->bytes += n;
+    r->write += n;
+}
+
+static int rewind_main(void* arg) {
+    RewindRing* r = (RewindRing*)arg;
+    SDL_LockMutex(r->lock);
+    while (!r->quit) {
+        if (r->q_count == 0) {
+            SDL_CondWait(r->cond, r->lock);
+            continue;
+        }
+        const Uint8* snap = r->queue + (size_t)r->q_head * r->snap_size;
+        r->busy = 1;
+        SDL_UnlockMutex(r->lock);
+
+        // delta e RLE fora do lock: 'last' e o slot da fila só são tocados por esta thread
+        PROF_BEGIN(pz);
+        size_t n = 0;
+        if (r->has_last) {
+            for (size_t i = 0; i < r->snap_size; ++i) r->delta[i] = snap[i] ^ r->last[i];
+            n = rewind_rle_encode(r->delta, r->snap_size, r->enc);
+        }
+        memcpy(r->last, snap, r->snap_size);
+        PROF_END(pz, "rewind encode");
+
+        SDL_LockMutex(r->lock);
+        if (r->has_last) rewind_push(r, r->enc, n);
+        r->has_last = 1;
+        r->q_head = (r->q_head + 1) % REWIND_QUEUE;
+        r->q_count--;
+        r->busy = 0;
+        SDL_CondBroadcast(r->cond);
+    }
+    SDL_UnlockMutex(r->lock);
+    return 0;
+}
+
+static int rewind_init(RewindRing* r) {
+    memset(r, 0, sizeof(*r));
+    r->lock = SDL_CreateMutex();
+    r->cond = SDL_CreateCond();
+    if (r->lock && r->cond) r->thread = SDL_CreateThread(rewind_main, "rewind", r);
+    if (!r->thread) SDL_Log("Falha ao criar a thread de rewind: %s", SDL_GetError());
+    return r->thread != NULL;
+}
+
+// espera a fila esvaziar (com lock)
+static void rewind_drain_locked(RewindRing* r) {
+    while (r->q_count > 0 || r->busy) SDL_CondWait(r->cond, r->lock);
+}
+
+static void rewind_free_buffers(RewindRing* r) {
+    free(r->queue);
+    free(r->ring);
+    free(r->entries);
+    free(r->last);
+    free(r->delta);
+    free(r->enc);
+    r->queue = r->ring = r->last = r->delta = r->enc = NULL;
+    r->entries = NULL;
+    r->q_head = r->q_count = 0;
+    r->write = r->bytes = 0;
+    r->e_head = r->e_count = 0;
+    r->has_last = 0;
+}
+
+// liga/desliga; ligar reserva o ring (as páginas só são tocadas conforme o histórico cresce)
+static void rewind_set_enabled(RewindRing* r, SimClock* sc, int on) {
+    if (!r->thread || on == r->enabled) return;
+    SDL_LockMutex(r->lock);
+    rewind_drain_locked(r);
+    rewind_free_buffers(r);
+    r->enabled = 0;
+    r->rewinding = 0;
+    if (on) {
+        r->snap_size = state_capture_size(sc);
+        r->queue = (Uint8*)malloc(r->snap_size * REWIND_QUEUE);
+        r->ring = (Uint8*)malloc(REWIND_BUDGET);
+        r->entries = (RewindEntry*)malloc(sizeof(RewindEntry) * REWIND_MAX_ENTRIES);
+        r->last = (Uint8*)malloc(r->snap_size);
+        r->delta = (Uint8*)malloc(r->snap_size);
+        r->enc = (Uint8*)malloc(rewind_rle_bound(r->snap_size));
+        r->enabled = r->queue && r->ring && r->entries && r->last && r->delta && r->enc;
+        if (!r->enabled) {
+            SDL_Log("malloc failed for rewind (%zu MB)", REWIND_BUDGET / (1024 * 1024));
+            rewind_free_buffers(r);
+        }
+        r->last_tick = sc->ticks;
+        r->dropped = 0;
+    }
+    SDL_UnlockMutex(r->lock);
+    rewindIndex = r->enabled;
+    SDL_Log("Rebobinar: %s", rewindOptions[rewindIndex]);
+}
+
+// depois dos passos de simulação do frame: um snapshot a cada REWIND_EVERY ticks
+static void rewind_capture(RewindRing* r, SimClock* sc) {
+    if (!r->enabled || r->rewinding) return;
+    if (sc->ticks >= r->last_tick && sc->ticks - r->last_tick < REWIND_EVERY) return;
+    r->last_tick = sc->ticks;
+    Uint64 t0 = SDL_GetPerformanceCounter();
+    PROF_BEGIN(pz);
+    SDL_LockMutex(r->lock);
+    if (r->q_count == REWIND_QUEUE) {
+        r->dropped++; // thread atrasada: perder um snapshot, nunca esperar
+    } else {
+        int slot = (r->q_head + r->q_count) % REWIND_QUEUE;
+        state_capture(r->queue + (size_t)slot * r->snap_size, r->snap_size, sc);
+        r->q_count++;
+        SDL_CondSignal(r->cond);
+    }
+    SDL_UnlockMutex(r->lock);
+    PROF_END(pz, "rewind capture");
+    r->capture_us = (float)((double)(SDL_GetPerformanceCounter() - t0) * 1e6 / (double)SDL_GetPerformanceFrequency());
+}
+
+// volta um snapshot; 0 se o histórico acabou
+static int rewind_step_back(RewindRing* r, SimClock* sc) {
+    if (!r->enabled) return 0;
+    SDL_LockMutex(r->lock);
+    rewind_drain_locked(r);
+    int ok = r->e_count > 0;
+    if (ok) {
+        int newest = (r->e_head + r->e_count - 1) % REWIND_MAX_ENTRIES;
+        const RewindEntry* e = &r->entries[newest];
+        ok = rewind_rle_xor(r->ring + e->offset, e->size, r->last, r->snap_size);
+        r->write = e->offset; // o espaço do delta usado volta a ser livre
+        r->bytes -= e->size;
+        r->e_count--;
+    }
+    if (ok) ok = state_restore(r->last, r->snap_size, sc, STATE_RESTORE_RESYNC);
+    r->last_tick = sc->ticks;
+    SDL_UnlockMutex(r->lock);
+    return ok;
+}
+
+static void rewind_destroy(RewindRing* r) {
+    if (r->thread) {
+        SDL_LockMutex(r->lock);
+        r->quit = 1;
+        SDL_CondBroadcast(r->cond);
+        SDL_UnlockMutex(r->lock);
+        SDL_WaitThread(r->thread, NULL);
+    }
+    rewind_free_buffers(r);
+    if (r->cond) SDL_DestroyCond(r->cond);
+    if (r->lock) SDL_DestroyMutex(r->lock);
+    memset(r, 0, sizeof(*r));
+}
+
+// histórico guardado (a thread do rewind altera e_count/bytes sob lock)
+static void rewind_stats(RewindRing* r, float* seconds, size_t* bytes, int* dropped) {
+    *seconds = 0.0f;
+    *bytes = 0;
+    *dropped = 0;
+    if (!r->lock) return;
+    SDL_LockMutex(r->lock);
+    *seconds = (float)r->e_count * REWIND_EVERY / SIM_HZ;
+    *bytes = r->bytes;
+    *dropped = r->dropped;
+    SDL_UnlockMutex(r->lock);
+}
+
+// muda a cada segundo de histórico (modal Rebobinar aberto)
+static Uint32 rewind_ui_stamp(RewindRing* r) {
+    float seconds;
+    size_t bytes;
+    int dropped;
+    rewind_stats(r, &seconds, &bytes, &dropped);
+    return (Uint32)seconds ^ (Uint32)r->enabled << 31 ^ (Uint32)dropped << 20;
+}
+
+static void drawRewindInfo(SDL_Renderer* renderer, GlyphAtlas* atlas, const Modal* m, SDL_Color textColor) {
+    RewindRing* r = &rewindRing;
+    int x = m->rect.x + 12, y = m->rect.y + 100;
+    int line_h = atlas->height > 0 ? atlas->height + 2 : 20;
+    char buf[128];
+    drawText(renderer, atlas, "Segure Backspace para voltar no tempo", x, y, textColor);
+    y += line_h;
+    if (!r->enabled) return;
+    float seconds;
+    size_t bytes;
+    int dropped;
+    rewind_stats(r, &seconds, &bytes, &dropped);
+    snprintf(buf, sizeof(buf), "%.0f s de histórico em %.1f MB (limite %zu MB)", seconds,
+             (double)bytes / (1024.0 * 1024.0), REWIND_BUDGET / (1024 * 1024));
+    drawText(renderer, atlas, buf, x, y, textColor);
+}
+
+// modais com conteúdo que muda sem evento (scan da Biblioteca, histórico do Rebobinar)
+static Uint32 modal_live_stamp(const Modal* m) {
+    if (!m->open) return 0;
+    if (m->kind == MODAL_LIBRARY) return library_ui_stamp(&library);
+    if (m->kind == MODAL_REWIND) return rewind_ui_stamp(&rewindRing);
+    return 0;
+}
+
+// -------------------- run-ahead --------------------
+// Configuração -> Controles: depois dos passos reais o estado vai para um buffer em
+// memória (state_capture), a simulação anda mais RUNAHEAD_STEPS por quadro escolhido
+// e o fundo/tema do frame saem desse estado adiantado. Antes dos eventos o estado real
+// volta (state_restore sem RESYNC: o relógio não salta), então o input sempre cai na
+// linha do tempo real e aparece na tela os quadros adiantados mais cedo.
+
+#define RUNAHEAD_STEPS (SIM_HZ / 60) // passos de simulação por quadro adiantado
+
+typedef struct {
+    Uint8* buf;      // estado real durante o frame
+    size_t size;
+    int active;
+    float cost_us;   // capture + passos + restore do último frame
+} RunAhead;
+
+static RunAhead runAhead = {0};
+
+// salva o estado real e adianta 'frames' quadros; retorna os passos adiantados
+static int run_ahead_begin(RunAhead* ra, SimClock* sc, int frames) {
+    if (frames <= 0) { ra->cost_us = 0.0f; return 0; }
+    Uint64 t0 = SDL_GetPerformanceCounter();
+    PROF_BEGIN(pz);
+    if (!ra->buf) {
+        ra->size = state_capture_size(sc);
+        ra->buf = (Uint8*)malloc(ra->size);
+        if (!ra->buf) { SDL_Log("malloc failed for run-ahead"); return 0; }
+    }
+    if (state_capture(ra->buf, ra->size, sc) != ra->size) return 0;
+    int steps = frames * RUNAHEAD_STEPS;
+    for (int s = 0; s < steps; ++s) sim_step((float)SIM_DT);
+    ra->active = 1;
+    PROF_END(pz, "run-ahead");
+    ra->cost_us = (float)((double)(SDL_GetPerformanceCounter() - t0) * 1e6 / (double)SDL_GetPerformanceFrequency());
+    return steps;
+}
+
+// volta ao estado real; a cor do tema já calculada para este frame continua na tela
+static void run_ahead_end(RunAhead* ra, SimClock* sc) {
+    if (!ra->active) return;
+    Uint64 t0 = SDL_GetPerformanceCounter();
+    PROF_BEGIN(pz);
+    Theme shown = currentTheme;
+    state_restore(ra->buf, ra->size, sc, 0);
+    currentTheme = shown;
+    ra->active = 0;
+    PROF_END(pz, "run-ahead restore");
+    ra->cost_us += (float)((double)(SDL_GetPerformanceCounter() - t0) * 1e6 / (double)SDL_GetPerformanceFrequency());
+}
+
+static void run_ahead_destroy(RunAhead* ra) {
+    free(ra->buf);
+    memset(ra, 0, sizeof(*ra));
+}
+
+// -------------------- UI + dirty-rect compositor --------------------
+// Em Economia o frame fica numa textura TARGET (Compositor). Quando só a UI mudou
+// (hover, dropdown abrindo/fechando, volume) apenas os retângulos afetados são
+// redesenhados nela, com fundo + UI recortados por SDL_RenderSetClipRect; o fundo
+// não é reenviado. Fundo novo, transição de tema, modal abrindo/fechando ou resize
+// redesenham tudo. Sem mudança visível o frame nem chega ao present.
+
+#define COMP_MAX_RECTS 8
+
+typedef struct {
+    SDL_Texture* target;
+    int w, h;
+    int failed;                     // sem render target: desenhar direto no backbuffer
+    int full;                       // próximo frame redesenha a tela inteira
+    int count;
+    SDL_Rect rects[COMP_MAX_RECTS];
+} Compositor;
+
+// o que a UI mostra; dois snapshots diferentes viram retângulos sujos
+typedef struct {
+    int valid;
+    int win_w, win_h;
+    float theme_t;
+    unsigned theme_gen;             // theme_generation: nova transição ou estado carregado
+    SDL_Rect menus[6];              // layout do menu (fullscreen, DPI)
+    Uint32 menu_hover;              // bit i = menu i destacado (bordas inclusivas: pode haver 2)
+    int menu_open;
+    SDL_Rect drop, vol;             // dropdown e sub-box de volume (w = 0 fechados)
+    Uint32 drop_hover, vol_hover;   // bit i = item i destacado
+    int modal_open;
+    char modal_title[128];
+    SDL_Rect modal_rect;
+    int modal_options;              // opções selecionáveis mostradas pelos modais
+    SDL_Rect vol_ind;               // indicador de volume
+    int volume, muted;
+} UiDamageState;
+
+static Compositor compositor = {0};
+
+// retângulos do dropdown aberto e da sub-box de volume (w = 0 quando fechados)
+static void openDropdownRects(SDL_Rect* drop, SDL_Rect* vol) {
+    *drop = (SDL_Rect){0, 0, 0, 0};
+    *vol = (SDL_Rect){0, 0, 0, 0};
+    if (menuSelecionado < 0) return;
+    int width = menuBoxes[menuSelecionado].w; if (width < DROPDOWN_MIN_WIDTH) width = DROPDOWN_MIN_WIDTH;
+    int draw_dx = calc_draw_x(menuBoxes[menuSelecionado].x, width);
+    *drop = (SDL_Rect){ draw_dx, MENU_HEIGHT, width, DROPDOWN_ITEM_HEIGHT * dropdownCounts[menuSelecionado] };
+    if (menuSelecionado == 3 && volumeDropdownOpen) {
+        int vdx = draw_dx + width;
+        int vwidth = VOLUME_SUB_WIDTH;
+        if (vdx + vwidth > win_w - EDGE_MARGIN) vdx = draw_dx - vwidth;
+        if (vdx < EDGE_MARGIN) vdx = EDGE_MARGIN;
+        *vol = (SDL_Rect){ vdx, MENU_HEIGHT, vwidth, DROPDOWN_ITEM_HEIGHT * volumeCount };
+    }
+}
+
+// UI inteira por cima do fundo (menu, dropdown + sub-box de volume, modal, indicador de volume)
+static void drawUi(SDL_Renderer* renderer, GlyphAtlas* atlas) {
+    PROF_BEGIN(pz_menu);
+    drawMenuBar(renderer, atlas);
+    PROF_END(pz_menu, "drawMenuBar");
+
+    // draw dropdown if open
+    if (menuSelecionado != -1) {
+        SDL_Rect drop, vRect;
+        openDropdownRects(&drop, &vRect);
+        PROF_BEGIN(pz);
+        drawDropdown(renderer, atlas, allDropdowns[menuSelecionado], dropdownCounts[menuSelecionado], drop.x, drop.y, drop.w);
+        PROF_END(pz, "drawDropdown");
+
+        // if audio menu and volumeDropdownOpen, draw subbox
+        if (vRect.w > 0) {
+            // draw subbox background using panel color
+            SDL_SetRenderDrawColor(renderer,
+                                   fcol_to_u8(currentTheme.panel.r),
+                                   fcol_to_u8(currentTheme.panel.g),
+                                   fcol_to_u8(currentTheme.panel.b),
+                                   fcol_to_u8(currentTheme.panel.a));
+            SDL_RenderFillRect(renderer, &vRect);
+            // draw items
+            PROF_BEGIN(pz_vol);
+            drawDropdown(renderer, atlas, volumeItems, volumeCount, vRect.x, vRect.y, vRect.w);
+            PROF_END(pz_vol, "drawDropdown");
+        }
+    }
+
+    // draw modal if open
+    PROF_BEGIN(pz_modal);
+    drawModal(renderer, atlas, &modal);
+    PROF_END(pz_modal, "drawModal");
+
+    // draw volume indicator
+    PROF_BEGIN(pz_vol_ind);
+    drawVolumeIndicator(renderer, atlas);
+    PROF_END(pz_vol_ind, "drawVolumeIndicator");
+}
+
+static int pointInRectIncl(int x, int y, const SDL_Rect* r) {
+    return x >= r->x && x <= r->x + r->w && y >= r->y && y <= r->y + r->h;
+}
+
+// itens de uma coluna destacados pelo mouse (mesmo teste de drawDropdown)
+static Uint32 item_hover_mask(const SDL_Rect* col, int count, int mx, int my) {
+    Uint32 mask = 0;
+    for (int i = 0; i < count && i < 32; ++i) {
+        SDL_Rect r = { col->x, col->y + i * DROPDOWN_ITEM_HEIGHT, col->w, DROPDOWN_ITEM_HEIGHT };
+        if (pointInRectIncl(mx, my, &r)) mask |= 1u << i;
+    }
+    return mask;
+}
+
+static void ui_damage_capture(UiDamageState* s, GlyphAtlas* atlas) {
+    int mx, my;
+    SDL_GetMouseState(&mx, &my);
+    memset(s, 0, sizeof(*s));
+    s->valid = 1;
+    s->win_w = win_w;
+    s->win_h = win_h;
+    s->theme_t = theme_t;
+    s->theme_gen = theme_generation;
+    memcpy(s->menus, menuBoxes, sizeof(s->menus));
+    for (int i = 0; i < numMenus; ++i)
+        if (pointInRectIncl(mx, my, &menuBoxes[i])) s->menu_hover |= 1u << i;
+    s->menu_open = menuSelecionado;
+    openDropdownRects(&s->drop, &s->vol);
+    if (s->drop.w > 0) s->drop_hover = item_hover_mask(&s->drop, dropdownCounts[menuSelecionado], mx, my);
+    if (s->vol.w > 0) s->vol_hover = item_hover_mask(&s->vol, volumeCount, mx, my);
+    s->modal_open = modal.open;
+    if (modal.open) {
+        memcpy(s->modal_title, modal.title, sizeof(s->modal_title));
+        s->modal_rect = modal.rect;
+        s->modal_options = (((((targetTheme.name[0] * 8 + bgScaleIndex) * 8 + dynResIndex) * 4 + renderModeIndex) * 4 +
+                            vsyncIndex) * 4 + bgBakeIndex) ^ (int)(cart_generation << 16);
+        s->modal_options ^= (int)modal_live_stamp(&modal);
+    }
+    s->volume = currentVolume;
+    s->muted = muted;
+    char buf[64];
+    if (muted) snprintf(buf, sizeof(buf), "Muted");
+    else snprintf(buf, sizeof(buf), "Vol: %d%%", currentVolume);
+    int tw = 0, th = 0;
+    measureText(atlas, buf, &tw, &th);
+    s->vol_ind = (SDL_Rect){ win_w - tw - 12, 6, tw, th };
+}
+
+static void comp_invalidate(Compositor* c) {
+    c->full = 1;
+    c->count = 0;
+}
+
+static void comp_add_rect(Compositor* c, SDL_Rect r) {
+    if (c->full || r.w <= 0 || r.h <= 0) return;
+    // +1: as bordas de hover são inclusivas
+    r.w += 1; r.h += 1;
+    // juntar com o que encosta; a união pode encostar em outro, então recomeçar
+    for (int i = 0; i < c->count; ++i) {
+        SDL_Rect grown = { c->rects[i].x - 1, c->rects[i].y - 1, c->rects[i].w + 2, c->rects[i].h + 2 };
+        if (SDL_HasIntersection(&grown, &r)) {
+            SDL_UnionRect(&c->rects[i], &r, &r);
+            c->rects[i] = c->rects[--c->count];
+            i = -1;
+        }
+    }
+    if (c->count == COMP_MAX_RECTS) {
+        for (int i = 0; i < c->count; ++i) SDL_UnionRect(&c->rects[i], &r, &r);
+        c->count = 0;
+    }
+    c->rects[c->count++] = r;
+}
+
+static void comp_add_items(Compositor* c, const SDL_Rect* col, Uint32 mask) {
+    for (int i = 0; mask; ++i, mask >>= 1)
+        if (mask & 1u) comp_add_rect(c, (SDL_Rect){ col->x, col->y + i * DROPDOWN_ITEM_HEIGHT, col->w, DROPDOWN_ITEM_HEIGHT });
+}
+
+// compara o snapshot anterior com o atual e marca o que precisa ser redesenhado
+static void comp_track_ui(Compositor* c, const UiDamageState* a, const UiDamageState* b) {
+    if (!a->valid || a->win_w != b->win_w || a->win_h != b->win_h || a->theme_t != b->theme_t ||
+        a->theme_gen != b->theme_gen || memcmp(a->menus, b->menus, sizeof(a->menus)) != 0 ||
+        a->modal_open != b->modal_open ||
+        (b->modal_open && (strcmp(a->modal_title, b->modal_title) != 0 || !SDL_RectEquals(&a->modal_rect, &b->modal_rect)))) {
+        // overlay do modal escurece a janela inteira; tema muda todas as cores
+        comp_invalidate(c);
+        return;
+    }
+    Uint32 menu_changed = a->menu_hover ^ b->menu_hover;
+    for (int i = 0; i < numMenus; ++i)
+        if (menu_changed & (1u << i)) comp_add_rect(c, menuBoxes[i]);
+    if (a->menu_open != b->menu_open || !SDL_RectEquals(&a->drop, &b->drop)) {
+        comp_add_rect(c, a->drop);
+        comp_add_rect(c, b->drop);
+    } else {
+        comp_add_items(c, &b->drop, a->drop_hover ^ b->drop_hover);
+    }
+    if (!SDL_RectEquals(&a->vol, &b->vol)) {
+        comp_add_rect(c, a->vol);
+        comp_add_rect(c, b->vol);
+    } else {
+        comp_add_items(c, &b->vol, a->vol_hover ^ b->vol_hover);
+    }
+    if (b->modal_open && a->modal_options != b->modal_options) comp_add_rect(c, b->modal_rect);
+    if (a->volume != b->volume || a->muted != b->muted) {
+        comp_add_rect(c, a->vol_ind);
+        comp_add_rect(c, b->vol_ind);
+    }
+}
+
+// 1 = desenhar no target (passes em comp_pass_clip); 0 = sem target, desenhar direto
+static int comp_begin(Compositor* c, SDL_Renderer* renderer, int w, int h) {
+    if (c->failed) return 0;
+    if (!c->target || c->w != w || c->h != h) {
+        if (c->target) SDL_DestroyTexture(c->target);
+        c->target = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+        if (!c->target) {
+            SDL_Log("Compositor desativado (render target indisponível): %s", SDL_GetError());
+            c->failed = 1;
+            return 0;
+        }
+        c->w = w;
+        c->h = h;
+        comp_invalidate(c);
+    }
+    if (SDL_SetRenderTarget(renderer, c->target) != 0) {
+        SDL_Log("SetRenderTarget failed: %s", SDL_GetError());
+        return 0;
+    }
+    return 1;
+}
+
+static int comp_pass_count(const Compositor* c) {
+    return c->full ? 1 : c->count;
+}
+
+static void comp_pass_clip(const Compositor* c, SDL_Renderer* renderer, int pass) {
+    SDL_RenderSetClipRect(renderer, c->full ? NULL : &c->rects[pass]);
+}
+
+// volta ao backbuffer e copia o frame composto; limpa a lista de sujos
+static void comp_end(Compositor* c, SDL_Renderer* renderer) {
+    SDL_RenderSetClipRect(renderer, NULL);
+    SDL_SetRenderTarget(renderer, NULL);
+    SDL_RenderCopy(renderer, c->target, NULL, NULL);
+    c->full = 0;
+    c->count = 0;
+}
+
+static void comp_destroy(Compositor* c) {
+    if (c->target) SDL_DestroyTexture(c->target);
+    memset(c, 0, sizeof(*c));
+}
+
+// UI retida: a UI é desenhada numa textura TARGET transparente só quando o snapshot
+// (UiDamageState) muda; nos outros frames ela entra com uma única cópia sobre o fundo.
+// O layer fica com alpha pré-multiplicado (o BLEND do SDL já produz isso sobre um
+// destino transparente; os preenchimentos da UI são opacos), então a cópia usa
+// ONE / ONE_MINUS_SRC_ALPHA. Renderer sem blend custom: drawUi() direto, como antes.
+
+typedef struct {
+    SDL_Texture* tex;
+    int w, h;
+    int failed;
+    int valid;                      // conteúdo corresponde a 'state'
+    UiDamageState state;
+    int redraws;                    // re-renderizações (HUD)
+} UiLayer;
+
+static UiLayer uiLayer = {0};
+
+static void ui_layer_invalidate(UiLayer* l) {
+    l->valid = 0;
+}
+
+// garante que o layer reflete 'now'; 0 = layer indisponível (usar drawUi)
+static int ui_layer_update(UiLayer* l, SDL_Renderer* renderer, GlyphAtlas* atlas, const UiDamageState* now) {
+    if (l->failed) return 0;
+    if (!l->tex || l->w != now->win_w || l->h != now->win_h) {
+        if (l->tex) SDL_DestroyTexture(l->tex);
+        l->tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, now->win_w, now->win_h);
+        SDL_BlendMode premul = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+                                                          SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+        if (!l->tex || SDL_SetTextureBlendMode(l->tex, premul) != 0) {
+            SDL_Log("UI retida desativada: %s", SDL_GetError());
+            if (l->tex) SDL_DestroyTexture(l->tex);
+            l->tex = NULL;
+            l->failed = 1;
+            return 0;
+        }
+        l->w = now->win_w;
+        l->h = now->win_h;
+        l->valid = 0;
+    }
+    // memset em ui_damage_capture zera o padding: memcmp compara só o estado
+    if (l->valid && memcmp(&l->state, now, sizeof(*now)) == 0) return 1;
+
+    SDL_Texture* prev_target = SDL_GetRenderTarget(renderer);
+    if (SDL_SetRenderTarget(renderer, l->tex) != 0) {
+        SDL_Log("SetRenderTarget failed: %s", SDL_GetError());
+        return 0;
+    }
+    PROF_BEGIN(pz);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    drawUi(renderer, atlas);
+    PROF_END(pz, "ui layer redraw");
+    SDL_SetRenderTarget(renderer, prev_target);
+    memcpy(&l->state, now, sizeof(*now));
+    l->valid = 1;
+    l->redraws++;
+    return 1;
+}
+
+static void ui_layer_draw(UiLayer* l, SDL_Renderer* renderer) {
+    SDL_RenderCopy(renderer, l->tex, NULL, NULL);
+}
+
+static void ui_layer_destroy(UiLayer* l) {
+    if (l->tex) SDL_DestroyTexture(l->tex);
+    memset(l, 0, sizeof(*l));
+}
+
+// -------------------- hit-test index --------------------
+// Widgets clicáveis (menus, itens do dropdown, sub-box de volume, botões do modal) com
+// um ID cada, guardados num grid uniforme de células HIT_CELL x HIT_CELL. O índice só
+// é refeito quando a chave de layout muda; cada evento de mouse custa uma célula e
+// poucos testes de retângulo. As bordas são inclusivas, como nos testes de desenho.
+
+#define HIT_CELL 32
+#define HIT_MAX_WIDGETS 64
+
+// ID = base | índice (menu, item, ou row * 16 + botão no modal)
+enum {
+    WID_NONE = 0,
+    WID_BACKDROP = 1,       // modal aberto: tudo fora dele
+    WID_MENUBAR = 2,        // barra de menu fora dos rótulos
+    WID_MODAL = 3,          // corpo do modal sem botão
+    WID_MODAL_CLOSE = 4,
+    WID_MENU = 0x100,
+    WID_DROP = 0x200,
+    WID_VOLUME = 0x300,
+    WID_MODAL_OPT = 0x400,
+    WID_LIB_ROW = 0x500     // linha visível da Biblioteca
+};
+#define WID_BASE(id) ((id) & ~0xff)
+#define WID_INDEX(id) ((id) & 0xff)
+
+typedef struct {
+    int win_w, win_h;
+    SDL_Rect menus[6];
+    int menu_open, vol_open;
+    int modal_open;
+    ModalKind modal_kind;
+    SDL_Rect modal_rect;
+} HitKey;
+
+typedef struct {
+    SDL_Rect r;
+    int id;
+} HitWidget;
+
+typedef struct {
+    int valid;
+    HitKey key;
+    HitWidget widgets[HIT_MAX_WIDGETS]; // prioridade: o primeiro que contém o ponto ganha
+    int count;
+    int cols, rows;
+    int* cell_start;                    // cols * rows + 1 (CSR)
+    Uint8* cell_items;                  // índices em widgets, em ordem de prioridade
+    int cap_cells, cap_items;
+    int builds;
+} HitIndex;
+
+static HitIndex hitIndex = {0};
+
+static void hit_key_capture(HitKey* k) {
+    memset(k, 0, sizeof(*k));
+    k->win_w = win_w;
+    k->win_h = win_h;
+    memcpy(k->menus, menuBoxes, sizeof(k->menus));
+    k->menu_open = menuSelecionado;
+    k->vol_open = volumeDropdownOpen;
+    k->modal_open = modal.open;
+    if (modal.open) {
+        k->modal_kind = modal.kind;
+        k->modal_rect = modal.rect;
+    }
+}
+
+static void hit_add(HitIndex* hi, SDL_Rect r, int id) {
+    if (hi->count < HIT_MAX_WIDGETS && r.w >= 0 && r.h >= 0) hi->widgets[hi->count++] = (HitWidget){ r, id };
+}
+
+static void hit_add_column(HitIndex* hi, const SDL_Rect* col, int count, int base) {
+    for (int i = 0; i < count; ++i)
+        hit_add(hi, (SDL_Rect){ col->x, col->y + i * DROPDOWN_ITEM_HEIGHT, col->w, DROPDOWN_ITEM_HEIGHT - 1 }, base | i);
+}
+
+// faixa de células coberta por [a, a + len] (inclusivo), recortada ao grid
+static void hit_cell_span(int a, int len, int n, int* c0, int* c1) {
+    *c0 = clamp_int(a / HIT_CELL, 0, n - 1);
+    *c1 = clamp_int((a + len) / HIT_CELL, 0, n - 1);
+    if (a + len < 0) *c1 = -1;
+}
+
+static int hit_index_build(HitIndex* hi) {
+    hit_key_capture(&hi->key);
+    hi->count = 0;
+    hi->valid = 0;
+    if (modal.open) {
+        // modal bloqueia o resto: botões, corpo e o fundo escurecido
+        hit_add(hi, modal.closeBtn, WID_MODAL_CLOSE);
+        ModalRow rows[MODAL_MAX_ROWS];
+        int nrows = modalRows(modal.kind, rows);
+        for (int r = 0; r < nrows; ++r)
+            for (int i = 0; i < rows[r].count; ++i) {
+                SDL_Rect b = modalOptionButtonRect(&modal, r, rows[r].count, i);
+                hit_add(hi, b, WID_MODAL_OPT | (r * 16 + i));
+            }
+        if (modal.kind == MODAL_LIBRARY)
+            for (int r = 0; r < library_visible_rows(&modal); ++r) hit_add(hi, libraryRowRect(&modal, r), WID_LIB_ROW | r);
+        hit_add(hi, modal.rect, WID_MODAL);
+        hit_add(hi, (SDL_Rect){ 0, 0, win_w, win_h }, WID_BACKDROP);
+    } else {
+        SDL_Rect drop, vol;
+        openDropdownRects(&drop, &vol);
+        if (vol.w > 0) hit_add_column(hi, &vol, volumeCount, WID_VOLUME);
+        for (int i = 0; i < numMenus; ++i)
+            hit_add(hi, (SDL_Rect){ menuBoxes[i].x, 0, menuBoxes[i].w, MENU_HEIGHT - 1 }, WID_MENU | i);
+        hit_add(hi, (SDL_Rect){ 0, 0, win_w, MENU_HEIGHT - 1 }, WID_MENUBAR);
+        if (drop.w > 0) hit_add_column(hi, &drop, dropdownCounts[menuSelecionado], WID_DROP);
+    }
+
+    hi->cols = win_w / HIT_CELL + 1;
+    hi->rows = win_h / HIT_CELL + 1;
+    int cells = hi->cols * hi->rows;
+    if (cells + 1 > hi->cap_cells) {
+        int* p = (int*)realloc(hi->cell_start, sizeof(int) * (size_t)(cells + 1));
+        if (!p) { SDL_Log("realloc failed for hit-test grid (%d cells)", cells); return 0; }
+        hi->cell_start = p;
+        hi->cap_cells = cells + 1;
+    }
+    // contagem por célula, prefix sum e preenchimento (mantém a ordem de prioridade)
+    memset(hi->cell_start, 0, sizeof(int) * (size_t)(cells + 1));
+    for (int w = 0; w < hi->count; ++w) {
+        const SDL_Rect* r = &hi->widgets[w].r;
+        int cx0, cx1, cy0, cy1;
+        hit_cell_span(r->x, r->w, hi->cols, &cx0, &cx1);
+        hit_cell_span(r->y, r->h, hi->rows, &cy0, &cy1);
+        for (int cy = cy0; cy <= cy1; ++cy)
+            for (int cx = cx0; cx <= cx1; ++cx) hi->cell_start[cy * hi->cols + cx + 1]++;
+    }
+    for (int c = 0; c < cells; ++c) hi->cell_start[c + 1] += hi->cell_start[c];
+    int total = hi->cell_start[cells];
+    if (total > hi->cap_items) {
+        Uint8* p = (Uint8*)realloc(hi->cell_items, (size_t)total);
+        if (!p) { SDL_Log("realloc failed for hit-test grid (%d entries)", total); return 0; }
+        hi->cell_items = p;
+        hi->cap_items = total;
+    }
+    int fill[2048];
+    int* cursor = cells <= 2048 ? fill : (int*)malloc(sizeof(int) * (size_t)cells);
+    if (!cursor) return 0;
+    memcpy(cursor, hi->cell_start, sizeof(int) * (size_t)cells);
+    for (int w = 0; w < hi->count; ++w) {
+        const SDL_Rect* r = &hi->widgets[w].r;
+        int cx0, cx1, cy0, cy1;
+        hit_cell_span(r->x, r->w, hi->cols, &cx0, &cx1);
+        hit_cell_span(r->y, r->h, hi->rows, &cy0, &cy1);
+        for (int cy = cy0; cy <= cy1; ++cy)
+            for (int cx = cx0; cx <= cx1; ++cx) hi->cell_items[cursor[cy * hi->cols + cx]++] = (Uint8)w;
+    }
+    if (cursor != fill) free(cursor);
+    hi->valid = 1;
+    hi->builds++;
+    return 1;
+}
+
+// widget sob (x,y) ou WID_NONE; refaz o índice se o layout mudou desde o último build
+static int hit_index_lookup(HitIndex* hi, int x, int y) {
+    HitKey k;
+    hit_key_capture(&k);
+    if (!hi->valid || memcmp(&k, &hi->key, sizeof(k)) != 0) {
+        if (!hit_index_build(hi)) return WID_NONE;
+    }
+    if (x < 0 || y < 0 || x >= hi->cols * HIT_CELL || y >= hi->rows * HIT_CELL)
+        return modal.open ? WID_BACKDROP : WID_NONE;
+    int c = (y / HIT_CELL) * hi->cols + x / HIT_CELL;
+    for (int i = hi->cell_start[c]; i < hi->cell_start[c + 1]; ++i) {
+        const HitWidget* w = &hi->widgets[hi->cell_items[i]];
+        if (x >= w->r.x && x <= w->r.x + w->r.w && y >= w->r.y && y <= w->r.y + w->r.h) return w->id;
+    }
+    return modal.open ? WID_BACKDROP : WID_NONE;
+}
+
+static void hit_index_free(HitIndex* hi) {
+    free(hi->cell_start);
+    free(hi->cell_items);
+    memset(hi, 0, sizeof(*hi));
+}
+
+// -------------------- bench (--bench) --------------------
+// Roda N frames do pipeline sem display (driver dummy + renderer por software num
+// SDL_Surface), com sementes fixas e passo de simulação fixo, e imprime por fase
+// min/mediana/p99 em ms e ns/pixel. Serve para comparar builds do kernel e do texto.
+
+static int bench_cmp_float(const void* a, const void* b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+// ordena 'ms' in-place; pixels > 0 acrescenta ns/pixel da mediana
+static void bench_report(const char* phase, float* ms, int n, long pixels) {
+    qsort(ms, (size_t)n, sizeof(float), bench_cmp_float);
+    float med = ms[n / 2];
+    printf("  %-14s min %8.3f  med %8.3f  p99 %8.3f ms", phase, ms[0], med, ms[(n - 1) * 99 / 100]);
+    if (pixels > 0) printf("  %7.3f ns/px", med * 1.0e6 / (double)pixels);
+    printf("\n");
+}
+
+static int run_bench(int frames, int w, int h, int threads, const char* kernel) {
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0); // respeita um driver escolhido no ambiente
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) { SDL_Log("SDL_Init error: %s", SDL_GetError()); return 1; }
+    if (TTF_Init() != 0) { SDL_Log("TTF_Init error: %s", TTF_GetError()); SDL_Quit(); return 1; }
+    if (!sweep_select_kernel(kernel)) { TTF_Quit(); SDL_Quit(); return 1; }
+
+    SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer* renderer = target ? SDL_CreateSoftwareRenderer(target) : NULL;
+    WorkerPool* pool = pool_create(threads);
+    TTF_Font* font = TTF_OpenFont("fonts/arial.ttf", 18);
+    int ok = renderer && pool && font;
+    if (!ok) SDL_Log("Bench: falha na inicialização: %s", SDL_GetError());
+
+    win_w = w; win_h = h;
+    if (ok) ok = recreateBackgroundTextures(NULL, renderer) && glyph_atlas_init(&uiAtlas, renderer, font, 18);
+
+    float* samples = ok ? (float*)malloc(sizeof(float) * 4 * (size_t)frames) : NULL;
+    if (ok && samples) {
+        float* t_sweep = samples;
+        float* t_upload = samples + frames;
+        float* t_ui = samples + 2 * frames;
+        float* t_present = samples + 3 * frames;
+        const double perf_ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+        // estado determinístico: sementes fixas, tema escuro, UI típica aberta
+        srand(1);
+        initThemes();
+        init_color_anims(3.0f);
+        menuSelecionado = 4;
+        openModalWithTitle(&modal, "Resolução");
+
+        SweepTables sweepTables = {0};
+        SweepParams sweepParams;
+        SweepJob sweepJob;
+        computeMenuBoxes(&uiAtlas, 0);
+
+        for (int f = 0; f < frames; ++f) {
+            sim_step((float)SIM_DT);
+            sim_apply_theme(1.0f);
+
+            Uint64 t0 = SDL_GetPerformanceCounter();
+            SDL_Texture* tex = bgTextures[bgTextureIndex];
+            Uint32* px = NULL;
+            int pitch = 0;
+            int locked = SDL_LockTexture(tex, NULL, (void**)&px, &pitch) == 0;
+            if (locked) {
+                float animR[3], animG[3], animB[3];
+                float accent[3] = { currentTheme.accent.r, currentTheme.accent.g, currentTheme.accent.b };
+                idle_anim_colors(1.0f, animR, animG, animB);
+                if (sweep_params_build(&sweepParams, &sweepTables, bg_w, bg_h, animR, animG, animB, accent,
+                                       currentTheme.idle_intensity, currentTheme.idle_gain)) {
+                    sweep_submit(pool, &sweepJob, &sweepParams, px, pitch / (int)sizeof(Uint32));
+                    pool_wait(pool);
+                }
+            }
+            Uint64 t1 = SDL_GetPerformanceCounter();
+            if (locked) SDL_UnlockTexture(tex);
+            SDL_RenderCopy(renderer, tex, NULL, NULL);
+            bgTextureIndex = (bgTextureIndex + 1) % BG_TEXTURE_COUNT;
+            Uint64 t2 = SDL_GetPerformanceCounter();
+
+            drawMenuBar(renderer, &uiAtlas);
+            int width = menuBoxes[menuSelecionado].w; if (width < DROPDOWN_MIN_WIDTH) width = DROPDOWN_MIN_WIDTH;
+            drawDropdown(renderer, &uiAtlas, allDropdowns[menuSelecionado], dropdownCounts[menuSelecionado],
+                         calc_draw_x(menuBoxes[menuSelecionado].x, width), MENU_HEIGHT, width);
+            drawModal(renderer, &uiAtlas, &modal);
+            drawVolumeIndicator(renderer, &uiAtlas);
+            Uint64 t3 = SDL_GetPerformanceCounter();
+
+            SDL_RenderPresent(renderer);
+            Uint64 t4 = SDL_GetPerformanceCounter();
+
+            t_sweep[f] = (float)((t1 - t0) * perf_ms);
+            t_upload[f] = (float)((t2 - t1) * perf_ms);
+            t_ui[f] = (float)((t3 - t2) * perf_ms);
+            t_present[f] = (float)((t4 - t3) * perf_ms);
+        }
+
+        printf("bench: %d frames, %dx%d, kernel %s, %d thread(s), driver %s\n",
+               frames, w, h, sweep_kernel_name, pool->num_threads + 1, SDL_GetCurrentVideoDriver());
+        bench_report("sweep fill", t_sweep, frames, (long)bg_w * bg_h);
+        bench_report("upload+copy", t_upload, frames, (long)w * h);
+        bench_report("ui draw", t_ui, frames, 0);
+        bench_report("present", t_present, frames, 0);
+        sweep_tables_free(&sweepTables);
+    }
+    free(samples);
+
+    text_cache_clear(&uiTextCache);
+    glyph_atlas_destroy(&uiAtlas);
+    destroyBackgroundTextures();
+    if (font) TTF_CloseFont(font);
+    if (pool) pool_destroy(pool);
+    if (renderer) SDL_DestroyRenderer(renderer);
+    if (target) SDL_FreeSurface(target);
+    TTF_Quit();
+    SDL_Quit();
+    return ok ? 0 : 1;
+}
+
 int main(int argc, char* argv[]) {
-    (void)argc; (void)argv;
+    // opções de linha de comando
+    int opt_threads = 0; // --threads N (0 = uma thread por CPU)
+    int opt_bench = 0;   // --bench N: N frames offscreen e relatório de tempos
+    int bench_w = 1280, bench_h = 720; // --size WxH (bench)
+    const char* opt_trace = NULL;      // --trace FILE: gravar desde o início (F9 alterna)
+    const char* opt_kernel = NULL;     // --kernel avx2|sse2|q15-sse2|q15|scalar (padrão: automático)
+    const char* opt_rom = NULL;        // --rom FILE: ROM usada pelo primeiro "Inserir Cartucho"
+    const char* opt_library = "roms";  // --library DIR: diretório da Biblioteca
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) opt_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--vsync") == 0) vsyncIndex = 1;
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) opt_trace = argv[++i];
+        else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) opt_kernel = argv[++i];
+        else if (strcmp(argv[i], "--rom") == 0 && i + 1 < argc) opt_rom = argv[++i];
+        else if (strcmp(argv[i], "--library") == 0 && i + 1 < argc) opt_library = argv[++i];
+        else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) opt_bench = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &bench_w, &bench_h) != 2 || bench_w <= 0 || bench_h <= 0) {
+                SDL_Log("Tamanho inválido: %s (use WxH)", argv[i]);
+                return 1;
+            }
+        }
+        else SDL_Log("Opção desconhecida: %s", argv[i]);
+    }
+    if (opt_bench > 0) return run_bench(opt_bench, bench_w, bench_h, opt_threads, opt_kernel);
     srand((unsigned)time(NULL));
 
     if (SDL_Init(SDL_INIT_VIDEO) != 0) { SDL_Log("SDL_Init error: %s", SDL_GetError()); return 1; }
     if (TTF_Init() != 0) { SDL_Log("TTF_Init error: %s", TTF_GetError()); SDL_Quit(); return 1; }
+    if (!sweep_select_kernel(opt_kernel)) sweep_select_kernel(NULL);
 
     SDL_Window* window = SDL_CreateWindow("Idle - Gray Sweep RGB + Menu DS",
                                           SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, DEFAULT_WIDTH, DEFAULT_HEIGHT,
                                           SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
     if (!window) { SDL_Log("CreateWindow error: %s", SDL_GetError()); TTF_Quit(); SDL_Quit(); return 1; }
 
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    Uint32 renderer_flags = SDL_RENDERER_ACCELERATED | (vsyncIndex ? SDL_RENDERER_PRESENTVSYNC : 0);
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, renderer_flags);
     if (!renderer) { SDL_Log("CreateRenderer error: %s", SDL_GetError()); SDL_DestroyWindow(window); TTF_Quit(); SDL_Quit(); return 1; }
-
-    if (!recreateTextureAndBufferFromWindow(window, renderer)) {
-        SDL_Log("Falha ao criar texture/buffer"); SDL_DestroyRenderer(renderer); SDL_DestroyWindow(window); TTF_Quit(); SDL_Quit(); return 1;
+    {
+        // o driver pode ignorar o pedido de vsync
+        SDL_RendererInfo info;
+        if (SDL_GetRendererInfo(renderer, &info) == 0) vsyncIndex = (info.flags & SDL_RENDERER_PRESENTVSYNC) ? 1 : 0;
     }
 
-    TTF_Font* font = TTF_OpenFont("fonts/arial.ttf", 18);
-    if (!font) { SDL_Log("Erro ao carregar fonte: %s", TTF_GetError()); free(pixels); SDL_DestroyTexture(texture); SDL_DestroyRenderer(renderer); SDL_DestroyWindow(window); TTF_Quit(); SDL_Quit(); return 1; }
-
-    // THEME: inicializar temas (darkTheme = tema atual; lightTheme = tema claro suave)
-    // Valores sugeridos (0..1 floats)
-    darkTheme = (Theme){
-            .name = "Dark Default",
-            .background = {0.06f,0.07f,0.08f,1.0f}, // #0f1113
-            .panel = {0.11f,0.11f,0.13f,1.0f},      // #1b1d20
-            .accent = {0.43f,0.70f,1.0f,1.0f},      // #6fb3ff
-            .text = {0.90f,0.93f,0.96f,1.0f},       // #e6eef6
-            .mutedText = {0.60f,0.66f,0.70f,1.0f},  // #9aa6b2
-            .menuBg = {0.08f,0.09f,0.10f,1.0f},
-            .menuHover = {0.16f,0.17f,0.18f,1.0f},
-            .idle_gain = 1.6f,
-            .idle_intensity = 0.7f
-    };
+    if (!recreateBackgroundTextures(window, renderer)) {
+        SDL_Log("Falha ao criar texturas de fundo"); SDL_DestroyRenderer(renderer); SDL_DestroyWindow(window); TTF_Quit(); SDL_Quit(); return 1;
+    }
 
-    lightTheme = (Theme){
-            .name = "Light Soft",
-            .background = {0.96f,0.97f,0.97f,1.0f}, // #f5f7f8
-            .panel = {1.0f,1.0f,1.0f,1.0f},         // #ffffff
-            .accent = {0.23f,0.51f,0.77f,1.0f},     // #3b82c4
-            .text = {0.06f,0.09f,0.13f,1.0f},       // #0f1720
-            .mutedText = {0.36f,0.42f,0.45f,1.0f},  // #5b6b73
-            .menuBg = {1.0f,1.0f,1.0f,1.0f},
-            .menuHover = {0.90f,0.94f,0.96f,1.0f},
-            .idle_gain = 3.0f,
-            .idle_intensity = 1.0f
-    };
+    const int font_size = 18;
+    TTF_Font* font = TTF_OpenFont("fonts/arial.ttf", font_size);
+    if (!font) { SDL_Log("Erro ao carregar fonte: %s", TTF_GetError()); destroyBackgroundTextures(); SDL_DestroyRenderer(renderer); SDL_DestroyWindow(window); TTF_Quit(); SDL_Quit(); return 1; }
+    if (!glyph_atlas_init(&uiAtlas, renderer, font, font_size)) {
+        SDL_Log("Falha ao criar glyph atlas"); TTF_CloseFont(font); destroyBackgroundTextures(); SDL_DestroyRenderer(renderer); SDL_DestroyWindow(window); TTF_Quit(); SDL_Quit(); return 1;
+    }
 
-    // start with dark theme
-    currentTheme = darkTheme;
-    targetTheme = darkTheme;
-    startTheme = darkTheme;
-    theme_t = 1.0f;
-    theme_duration = 0.0f;
+    initThemes();
 
     int running = 1;
     SDL_Event event;
@@ -686,51 +5191,214 @@ int main(int argc, char* argv[]) {
     int last_h = win_h;
     int need_recreate = 0;
 
-    // timing for animations
-    Uint32 last_time = SDL_GetTicks();
+    // timing for animations: passos fixos de SIM_DT (ver simulation clock)
     init_color_anims(3.0f); // base duration in seconds (tweak as needed)
+    SimClock simClock;
+    sim_clock_init(&simClock);
 
     // We'll compute an anim tint each frame from colorAnims[0] to subtly tint accent
     float animTint[3] = {0.0f, 0.0f, 0.0f};
 
+    // tabelas sin/cos por linha/coluna do sweep (reaproveitadas entre frames)
+    SweepTables sweepTables = {0};
+    SweepParams sweepParams;
+    SweepJob sweepJob;
+
+    // controlador de resolução automática (tempos em ms via SDL_GetPerformanceCounter)
+    DynResController dynRes;
+    dynres_reset(&dynRes);
+    const double perf_ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+    // agendamento dos frames na taxa do monitor (sem vsync)
+    FramePacer pacer = {0};
+    frame_pacer_from_display(&pacer, window);
+
+    // pool persistente para o sweep (join uma vez por frame)
+    WorkerPool* pool = pool_create(opt_threads);
+    if (!pool) {
+        SDL_Log("Falha ao criar worker pool"); glyph_atlas_destroy(&uiAtlas); TTF_CloseFont(font); destroyBackgroundTextures(); SDL_DestroyRenderer(renderer); SDL_DestroyWindow(window); TTF_Quit(); SDL_Quit(); return 1;
+    }
+    SDL_Log("Idle sweep: %d worker(s) + main thread", pool->num_threads);
+
+    // keyframes do fundo (Configuração -> Vídeo -> Keyframes); a thread dorme até o primeiro restart
+    BgBaker bgBaker;
+    bg_baker_init(&bgBaker);
+    // índice publicado logo; ROMs novas/alteradas são hasheadas em segundo plano
+    if (library_init(&library, opt_library)) library_scan(&library);
+    // Sistema -> Salvar Estado: fwrite/fsync fora do frame loop
+    state_writer_init(&stateWriter);
+    // Sistema -> Rebobinar: o ring só é alocado quando ligado
+    rewind_init(&rewindRing);
+
+    if (opt_trace) {
+        prof_path = opt_trace;
+        prof_start();
+    }
+    int prof_toggle = 0; // F9: aplicado depois do join do sweep
+
+    // render sob demanda: frame_dirty marca input/estado novo; a idle animation anda a IDLE_ANIM_FPS
+    int frame_dirty = 1;
+    UiDamageState ui_prev = {0};  // estado da UI no último frame composto (Economia)
+    Uint32 live_stamp = 0;        // Biblioteca/Rebobinar abertos: scan e histórico mudam sem evento
+    double last_bake_pos = -1.0;  // posição dos keyframes no target composto
+    int last_use_bake = 0;
+    int window_hidden = (SDL_GetWindowFlags(window) & (SDL_WINDOW_HIDDEN | SDL_WINDOW_MINIMIZED)) ? 1 : 0;
+    const Uint32 idle_step_ms = 1000 / IDLE_ANIM_FPS;
+    Uint32 last_idle_frame = 0;
+
     while (running) {
+        // janela escondida: não há o que desenhar, só acordar para eventos.
+        // Economia sem nada sujo: dormir até o próximo evento ou o próximo passo da idle animation
+        if (window_hidden) {
+            SDL_WaitEventTimeout(NULL, 250);
+        } else if (renderModeIndex == 1 && !frame_dirty && theme_t >= 1.0f) {
+            Uint32 since = SDL_GetTicks() - last_idle_frame;
+            if (since < idle_step_ms) SDL_WaitEventTimeout(NULL, (int)(idle_step_ms - since));
+        }
+
+        PROF_BEGIN(pz_frame);
         Uint32 flags = SDL_GetWindowFlags(window);
         int is_fullscreen = (flags & SDL_WINDOW_FULLSCREEN_DESKTOP) ? 1 : 0;
 
-        // compute menu boxes using fullscreen flag
-        computeMenuBoxes(font, is_fullscreen);
+        // timing: simular os passos fixos pendentes (tema + color anims) e interpolar para o render
+        int sim_steps = sim_clock_advance(&simClock);
+        if (rewindRing.rewinding) {
+            // Backspace: um snapshot para trás por frame no lugar dos passos
+            if (rewind_step_back(&rewindRing, &simClock)) frame_dirty = 1;
+            sim_steps = 0;
+        }
+        for (int s = 0; s < sim_steps; ++s) sim_step((float)SIM_DT);
+        rewind_capture(&rewindRing, &simClock);
+        // Controles -> run-ahead: o render deste frame mostra o estado adiantado
+        int ahead_steps = run_ahead_begin(&runAhead, &simClock, rewindRing.rewinding ? 0 : runAheadIndex);
+        float sim_alpha = sim_clock_alpha(&simClock);
+        sim_apply_theme(sim_alpha);
+
+        // compute animTint from first ColorAnim to tint accent subtly
+        sim_anim_color(0, sim_alpha, animTint);
 
-        // timing
-        Uint32 now = SDL_GetTicks();
-        float delta = (now - last_time) / 1000.0f;
-        if (delta > 0.1f) delta = 0.1f;
-        last_time = now;
+        // recriar texturas pendentes (resize/fullscreen do frame anterior) antes do sweep
+        if (need_recreate) {
+            if (!recreateBackgroundTextures(window, renderer)) {
+                SDL_Log("Falha ao recriar texturas de fundo");
+            }
+            need_recreate = 0;
+        }
 
-        // THEME: advance theme transition
-        if (theme_t < 1.0f) {
-            theme_t += delta / (theme_duration > 0.0f ? theme_duration : 0.45f);
-            if (theme_t > 1.0f) theme_t = 1.0f;
-            theme_lerp(&startTheme, &targetTheme, theme_t, &currentTheme);
+        // compute menu boxes using fullscreen flag (só quando o layout foi invalidado)
+        if (menuLayoutDirty) {
+            PROF_BEGIN(pz);
+            computeMenuBoxes(&uiAtlas, is_fullscreen);
+            PROF_END(pz, "computeMenuBoxes");
+            menuLayoutDirty = 0;
         }
 
-        // update color animations (use currentTheme.idle_intensity to scale base speed)
-        float speedMultiplier = 1.0f;
-        update_color_anims(delta, speedMultiplier);
+        // Keyframes: com o tema parado o fundo vem do ring pré-calculado; antes de ficar
+        // pronto (ou durante transições de tema) o sweep ao vivo continua cobrindo.
+        double bake_pos = -1.0;
+        int use_bake = 0;
+        int bake_step = 0;
+        // rebobinando o tempo salta todo frame: sweep ao vivo até soltar o Backspace
+        if (bgBakeIndex == 1 && theme_t >= 1.0f && !window_hidden && !rewindRing.rewinding) {
+            int kw = drawable_w / BAKE_DIV; if (kw < 1) kw = 1;
+            int kh = drawable_h / BAKE_DIV; if (kh < 1) kh = 1;
+            Uint64 shown_tick = simClock.ticks + ahead_steps;
+            shown_tick = shown_tick > 0 ? shown_tick - 1 : 0; // render mostra prev -> atual
+            if (bgBaker.theme_gen != theme_generation || bgBaker.timeline != sim_timeline || kw != bgBaker.w || kh != bgBaker.h ||
+                bg_baker_behind(&bgBaker, shown_tick))
+                bg_baker_restart(&bgBaker, renderer, colorAnimsPrev, shown_tick, kw, kh);
+            bake_pos = ((double)((Sint64)shown_tick - (Sint64)bgBaker.tick0) + sim_alpha) / BAKE_KF_STEPS;
+            use_bake = bg_baker_acquire(&bgBaker, bake_pos);
+            // Economia: o fundo pré-calculado também anda no passo da idle animation
+            if (use_bake && SDL_GetTicks() - last_idle_frame >= idle_step_ms) {
+                frame_dirty = 1;
+                bake_step = 1;
+                last_idle_frame = SDL_GetTicks();
+            }
+        } else if (bgBaker.w) {
+            bg_baker_stop(&bgBaker);
+        }
 
-        // compute animTint from first ColorAnim to tint accent subtly
-        get_anim_color(&colorAnims[0], animTint);
+        // 1) travar a próxima textura de fundo e disparar o preenchimento com a idle animation
+        //    (usando colorAnims e currentTheme) nos workers; os eventos abaixo são processados
+        //    enquanto o pool preenche. A outra textura pode continuar em uso pelo renderer.
+        //    Em Economia o sweep só roda no passo da idle animation ou durante a transição de tema;
+        //    frames só de input reaproveitam a última textura pronta. Escondida: nunca roda.
+        int run_sweep = !window_hidden && !use_bake &&
+                        (renderModeIndex == 0 || theme_t < 1.0f || bgReadyIndex < 0 ||
+                         SDL_GetTicks() - last_idle_frame >= idle_step_ms);
+        SDL_Texture* sweepTexture = run_sweep ? bgTextures[bgTextureIndex] : NULL;
+        Uint32* sweepPixels = NULL;
+        int sweepPitch = 0;
+        if (sweepTexture && SDL_LockTexture(sweepTexture, NULL, (void**)&sweepPixels, &sweepPitch) != 0) {
+            SDL_Log("LockTexture failed: %s", SDL_GetError());
+            sweepPixels = NULL;
+        }
+        int sweep_pending = 0;
+        float sweep_ms = 0.0f;
+        if (sweepPixels) {
+            // parâmetros locais
+            const float intensity = currentTheme.idle_intensity; // escala base
+            const float gain = currentTheme.idle_gain;           // punch
+
+            // --- remap anims por tema (dinâmico) ---
+            float animR[3], animG[3], animB[3];
+            idle_anim_colors(sim_alpha, animR, animG, animB);
+
+            // precompute accent tint (0..1)
+            float accent[3] = { currentTheme.accent.r, currentTheme.accent.g, currentTheme.accent.b };
+
+            // preencher pixels (procedural sweep) em faixas de linhas no pool, respeitando o pitch
+            PROF_BEGIN(pz_params);
+            int params_ok = sweep_params_build(&sweepParams, &sweepTables, bg_w, bg_h, animR, animG, animB, accent, intensity, gain);
+            PROF_END(pz_params, "sweep params");
+            if (params_ok) {
+                sweep_submit(pool, &sweepJob, &sweepParams, sweepPixels, sweepPitch / (int)sizeof(Uint32));
+                sweep_pending = 1;
+                last_idle_frame = SDL_GetTicks();
+            } else {
+                SDL_UnlockTexture(sweepTexture);
+            }
+        }
+
+        // params do sweep e keyframes já saíram do estado adiantado: eventos partem do real
+        run_ahead_end(&runAhead, &simClock);
 
         // process events; mark need_recreate when size changes
+        PROF_BEGIN(pz_events);
         while (SDL_PollEvent(&event)) {
+            frame_dirty = 1; // qualquer evento pode mudar hover/menus/modal
             if (event.type == SDL_QUIT) { running = 0; }
             else if (event.type == SDL_WINDOWEVENT) {
-                if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
+                if (event.window.event == SDL_WINDOWEVENT_HIDDEN || event.window.event == SDL_WINDOWEVENT_MINIMIZED) {
+                    window_hidden = 1;
+                }
+                else if (event.window.event == SDL_WINDOWEVENT_SHOWN || event.window.event == SDL_WINDOWEVENT_RESTORED ||
+                         event.window.event == SDL_WINDOWEVENT_MAXIMIZED) {
+                    window_hidden = 0;
+                }
+                else if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
                     int new_w = event.window.data1, new_h = event.window.data2;
                     if (new_w != last_w || new_h != last_h) {
                         last_w = new_w; last_h = new_h;
                         need_recreate = 1;
                     }
                 }
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+                else if (event.window.event == SDL_WINDOWEVENT_DISPLAY_CHANGED) {
+                    // outro monitor pode ter outro DPI: drawable e layout precisam ser refeitos
+                    need_recreate = 1;
+                    frame_pacer_from_display(&pacer, window);
+                }
+#endif
+                else if (event.window.event == SDL_WINDOWEVENT_MOVED) {
+                    // pode ter mudado de monitor (e de taxa de atualização)
+                    frame_pacer_from_display(&pacer, window);
+                }
+            } else if (event.type == SDL_RENDER_TARGETS_RESET || event.type == SDL_RENDER_DEVICE_RESET) {
+                // conteúdo dos targets foi perdido
+                comp_invalidate(&compositor);
+                ui_layer_invalidate(&uiLayer);
             } else if (event.type == SDL_KEYDOWN) {
                 if (event.key.keysym.sym == SDLK_ESCAPE) { if (modal.open) modal.open = 0; else running = 0; }
                 // quick theme toggle for testing: T toggles theme
@@ -738,227 +5406,182 @@ int main(int argc, char* argv[]) {
                     if (strcmp(currentTheme.name, "Dark Default") == 0) startThemeTransition(&lightTheme, 0.45f);
                     else startThemeTransition(&darkTheme, 0.45f);
                 }
+                // F9: iniciar/parar a gravação do profiler (parar salva o trace)
+                if (event.key.keysym.sym == SDLK_F9) prof_toggle = 1;
+                // F3: HUD de desempenho
+                if (event.key.keysym.sym == SDLK_F3) perfHud.visible = !perfHud.visible;
+                // Backspace segurado: rebobinar (Sistema -> Rebobinar ligado)
+                if (event.key.keysym.sym == SDLK_BACKSPACE) rewindRing.rewinding = rewindRing.enabled;
+            } else if (event.type == SDL_KEYUP) {
+                if (event.key.keysym.sym == SDLK_BACKSPACE) rewindRing.rewinding = 0;
             }
                 // --- hover handling para abrir/fechar volumeDropdownOpen ---
             else if (event.type == SDL_MOUSEMOTION) {
-                int mx = event.motion.x, my = event.motion.y;
-
-                // se o menu Áudio estiver aberto (menuSelecionado == 3), detecta hover sobre itens
+                // menu Áudio aberto: hover em "Volume" abre a sub-box; ela fica aberta enquanto
+                // o mouse está sobre ela; qualquer outro lugar fecha
                 if (menuSelecionado == 3) {
-                    int dx = menuBoxes[3].x;
-                    int dy = MENU_HEIGHT;
-                    int width = menuBoxes[3].w; if (width < DROPDOWN_MIN_WIDTH) width = DROPDOWN_MIN_WIDTH;
-                    int draw_dx = calc_draw_x(dx, width);
-                    int itemH = DROPDOWN_ITEM_HEIGHT;
-                    int count = dropdownCounts[3];
-
-                    SDL_Rect dropRect = { draw_dx, dy, width, itemH * count };
-
-                    if (mx >= dropRect.x && mx <= dropRect.x + dropRect.w && my >= dropRect.y && my <= dropRect.y + dropRect.h) {
-                        int idx = (my - dropRect.y) / itemH;
-                        if (idx >= 0 && idx < count) {
-                            const char* hovered = allDropdowns[3][idx];
-                            if (hovered && strcmp(hovered, "Volume") == 0) {
-                                volumeDropdownOpen = 1;
-                            } else {
-                                volumeDropdownOpen = 0;
-                            }
-                        } else {
-                            volumeDropdownOpen = 0;
-                        }
-                    } else {
-                        // se não estiver sobre o dropdown, permite manter aberto apenas se o mouse estiver sobre a subcaixa de volume
-                        int vwidth = VOLUME_SUB_WIDTH;
-                        int vdx = draw_dx + width;
-                        int vdy = dy;
-                        if (vdx + vwidth > win_w - EDGE_MARGIN) vdx = draw_dx - vwidth;
-                        if (vdx < EDGE_MARGIN) vdx = EDGE_MARGIN;
-                        SDL_Rect vRect = { vdx, vdy, vwidth, itemH * volumeCount };
-                        if (!(mx >= vRect.x && mx <= vRect.x + vRect.w && my >= vRect.y && my <= vRect.y + vRect.h)) {
-                            volumeDropdownOpen = 0;
-                        }
-                    }
+                    int id = hit_index_lookup(&hitIndex, event.motion.x, event.motion.y);
+                    if (WID_BASE(id) == WID_DROP) volumeDropdownOpen = allDropdownActions[3][WID_INDEX(id)] == ACT_VOLUME;
+                    else if (WID_BASE(id) != WID_VOLUME) volumeDropdownOpen = 0;
                 } else {
                     // se menu Áudio não está aberto, fecha subbox
                     volumeDropdownOpen = 0;
                 }
-
-                // não alterar menuSelecionado aqui; apenas hover para subbox
                 continue;
+            }
+            else if (event.type == SDL_MOUSEWHEEL) {
+                if (modal.open && modal.kind == MODAL_LIBRARY) library_scroll_by(&library, &modal, -event.wheel.y * 3);
+            }
+            else if (event.type == SDL_DROPFILE) {
+                // arrastar uma ROM para a janela insere o cartucho
+                if (cart_insert(&cart, event.drop.file) && modal.open && modal.kind == MODAL_CART_INSERT)
+                    openModalWithTitle(&modal, "Info");
+                SDL_free(event.drop.file);
             }
                 // --- clique do mouse (LEFT) ---
             else if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT) {
-                int mx = event.button.x, my = event.button.y;
+                int id = hit_index_lookup(&hitIndex, event.button.x, event.button.y);
+                int idx = WID_INDEX(id);
 
-                // modal handling (custom for theme modal)
+                // modal aberto: fechar (X ou clique fora), botões de opção, ou nada
                 if (modal.open) {
-                    // clique no botão fechar
-                    if (isPointInRect(mx, my, &modal.closeBtn)) { modal.open = 0; continue; }
-
-                    // se clicou dentro do modal
-                    if (isPointInRect(mx, my, &modal.rect)) {
-                        // se for modal de tema, detectar clique nos botões
-                        if (strcmp(modal.title, "Tema") == 0) {
-                            int padding = 12;
-                            int btnW = (modal.rect.w - padding*3) / 2;
-                            int btnH = 36;
-                            int bx = modal.rect.x + padding;
-                            int by = modal.rect.y + 48;
-                            for (int i = 0; i < themeOptionsCount; ++i) {
-                                SDL_Rect btn = { bx + i * (btnW + padding), by, btnW, btnH };
-                                if (mx >= btn.x && mx <= btn.x + btn.w && my >= btn.y && my <= btn.y + btn.h) {
-                                    // aplicar tema correspondente
-                                    if (strcmp(themeOptions[i], "Escuro") == 0) {
-                                        startThemeTransition(&darkTheme, 0.45f);
-                                    } else {
-                                        startThemeTransition(&lightTheme, 0.45f);
-                                    }
-                                    modal.open = 0;
-                                    break;
-                                }
-                            }
-                            continue;
-                        }
-
-                        // clique dentro do modal, mas não no conteúdo específico: ignorar (mantém aberto)
-                        continue;
-                    } else {
-                        // clique fora do modal fecha
-                        modal.open = 0;
-                        continue;
-                    }
-                }
-
-                // se a subcaixa de volume estiver aberta, tratar clique nela primeiro
-                if (volumeDropdownOpen) {
-                    int dx = menuBoxes[3].x;
-                    int dy = MENU_HEIGHT;
-                    int width = menuBoxes[3].w; if (width < DROPDOWN_MIN_WIDTH) width = DROPDOWN_MIN_WIDTH;
-                    int draw_dx = calc_draw_x(dx, width);
-                    int itemH = DROPDOWN_ITEM_HEIGHT;
-
-                    // posição da subcaixa de volume (vRect)
-                    int vwidth = VOLUME_SUB_WIDTH;
-                    int vdx = draw_dx + width;
-                    int vdy = dy;
-                    if (vdx + vwidth > win_w - EDGE_MARGIN) vdx = draw_dx - vwidth;
-                    if (vdx < EDGE_MARGIN) vdx = EDGE_MARGIN;
-                    SDL_Rect vRect = {vdx, vdy, vwidth, itemH * volumeCount};
-
-                    // posição do dropdown pai (dropRect)
-                    int count = dropdownCounts[3];
-                    SDL_Rect dropRect = { draw_dx, dy, width, itemH * count };
-
-                    // 1) clique dentro da subcaixa de volume -> selecionar porcentagem
-                    if (mx >= vRect.x && mx <= vRect.x + vRect.w && my >= vRect.y && my <= vRect.y + vRect.h) {
-                        int idx = (my - vRect.y) / itemH;
-                        if (idx >= 0 && idx < volumeCount) {
-                            currentVolume = idx * 10;
-                            muted = 0;
-                            SDL_Log("Volume set to %d%%", currentVolume);
-                            volumeDropdownOpen = 0;
-                        }
+                    if (id == WID_MODAL_CLOSE || id == WID_BACKDROP) { modal.open = 0; continue; }
+                    if (WID_BASE(id) == WID_LIB_ROW) {
+                        // linha da Biblioteca: inserir e mostrar o Info
+                        char path[1024];
+                        if (library_row_path(&library, idx, path, sizeof(path)) && cart_insert(&cart, path))
+                            openModalWithTitle(&modal, "Info");
                         continue;
                     }
-
-                    // 2) clique dentro do dropdown pai
-                    if (mx >= dropRect.x && mx <= dropRect.x + dropRect.w && my >= dropRect.y && my <= dropRect.y + dropRect.h) {
-                        int idx = (my - dropRect.y) / itemH;
-                        if (idx >= 0 && idx < count) {
-                            const char* escolha = allDropdowns[3][idx];
-                            // se clicou em "Volume", IGNORAR clique (hover controla abertura) e manter subcaixa aberta
-                            if (escolha && strcmp(escolha, "Volume") == 0) {
-                                // nada a fazer; mantemos menu e subcaixa
-                                continue;
+                    if (WID_BASE(id) != WID_MODAL_OPT) continue; // corpo do modal: mantém aberto
+                    int row = idx / 16, i = idx % 16;
+                    switch (modal.kind) {
+                    case MODAL_THEME:
+                        // aplicar tema correspondente
+                        startThemeTransition(i == 0 ? &darkTheme : &lightTheme, 0.45f);
+                        break;
+                    case MODAL_RESOLUTION:
+                        // escala fixa (volta para Manual) ou modo automático
+                        if (row == 0) {
+                            dynResIndex = 0;
+                            if (i != bgScaleIndex) {
+                                bgScaleIndex = i;
+                                need_recreate = 1;
+                                SDL_Log("Resolução do fundo: %s", bgScaleOptions[i]);
                             }
-                            // caso contrário, deixe o fluxo normal tratar o clique (ex.: Mute, Mixer)
-                            // mas fechamos a subcaixa porque o clique foi em outro item do dropdown
-                            volumeDropdownOpen = 0;
-                            // não 'continue' aqui: deixamos o restante do handler processar a ação do item
                         } else {
-                            // clique dentro do dropRect mas fora dos itens válidos -> fechar subcaixa
-                            volumeDropdownOpen = 0;
+                            dynResIndex = i;
+                            dynres_reset(&dynRes);
+                            SDL_Log("Resolução do fundo: %s", dynResOptions[i]);
                         }
-                    } else {
-                        // 3) clique fora de ambas as áreas -> fechar subcaixa
-                        volumeDropdownOpen = 0;
+                        break;
+                    case MODAL_VIDEO:
+                        if (row == 0) {
+                            // modo de renderização (contínuo / economia)
+                            renderModeIndex = i;
+                            SDL_Log("Renderização: %s", renderModeOptions[i]);
+                        } else if (row == 1 && i != vsyncIndex) {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+                            if (SDL_RenderSetVSync(renderer, i) == 0) {
+                                vsyncIndex = i;
+                                pacer.deadline = 0;
+                                SDL_Log("Vídeo: %s", vsyncOptions[i]);
+                            } else {
+                                SDL_Log("RenderSetVSync failed: %s", SDL_GetError());
+                            }
+#else
+                            SDL_Log("VSync só pode ser escolhido na inicialização com esta SDL (use --vsync)");
+#endif
+                        } else if (row == 2) {
+                            bgBakeIndex = i;
+                            SDL_Log("Fundo: %s", bgBakeOptions[i]);
+                        }
+                        break;
+                    case MODAL_REWIND:
+                        rewind_set_enabled(&rewindRing, &simClock, i);
+                        break;
+                    case MODAL_CONTROLS:
+                        runAheadIndex = i;
+                        SDL_Log("Run-ahead: %s", runAheadOptions[i]);
+                        break;
+                    default:
+                        break;
                     }
+                    modal.open = 0;
+                    continue;
+                }
+
+                // 1) clique na subcaixa de volume -> selecionar porcentagem (menu continua aberto)
+                if (WID_BASE(id) == WID_VOLUME) {
+                    currentVolume = idx * 10;
+                    muted = 0;
+                    SDL_Log("Volume set to %d%%", currentVolume);
+                    volumeDropdownOpen = 0;
+                    continue;
                 }
+                MenuAction action = WID_BASE(id) == WID_DROP ? allDropdownActions[menuSelecionado][idx] : ACT_MODAL;
+                // clique em "Volume" é ignorado (hover controla a sub-box); qualquer outro clique a fecha
+                if (WID_BASE(id) == WID_DROP && action == ACT_VOLUME) continue;
+                volumeDropdownOpen = 0;
 
                 // clique na barra de menu (abre/fecha menus)
-                if (my >= 0 && my < MENU_HEIGHT) {
-                    int clickedMenu = -1;
-                    for (int i = 0; i < numMenus; ++i) {
-                        SDL_Rect m = menuBoxes[i];
-                        if (mx >= m.x && mx <= m.x + m.w) { clickedMenu = i; break; }
-                    }
-                    if (clickedMenu >= 0) {
-                        if (menuSelecionado == clickedMenu) { menuSelecionado = -1; volumeDropdownOpen = 0; }
-                        else { menuSelecionado = clickedMenu; volumeDropdownOpen = 0; }
-                    }
+                if (WID_BASE(id) == WID_MENU) {
+                    menuSelecionado = menuSelecionado == idx ? -1 : idx;
                     continue;
                 }
+                if (id == WID_MENUBAR) continue;
 
-                // clique dentro de um dropdown aberto
-                if (menuSelecionado != -1) {
-                    int dx = menuBoxes[menuSelecionado].x;
-                    int dy = MENU_HEIGHT;
-                    int itemH = DROPDOWN_ITEM_HEIGHT;
-                    int count = dropdownCounts[menuSelecionado];
-                    int width = menuBoxes[menuSelecionado].w; if (width < DROPDOWN_MIN_WIDTH) width = DROPDOWN_MIN_WIDTH;
-
-                    int draw_dx = calc_draw_x(dx, width);
-                    SDL_Rect dropRect = {draw_dx, dy, width, itemH * count};
-
-                    if (count > 0 && mx >= dropRect.x && mx <= dropRect.x + dropRect.w && my >= dropRect.y && my <= dropRect.y + dropRect.h) {
-                        int idx = (my - dropRect.y) / itemH;
-                        if (idx >= 0 && idx < count) {
-                            const char* escolha = allDropdowns[menuSelecionado][idx];
-
-                            // se for o item "Volume" no menu Áudio, IGNORAR clique (hover controla abertura)
-                            if (menuSelecionado == 3 && escolha && strcmp(escolha, "Volume") == 0) {
-                                // nada a fazer; mantemos o menu aberto e a subcaixa controlada por hover
-                            }
-                            else if (menuSelecionado == 0) {
-                                if (strcmp(escolha, "Sair") == 0) running = 0;
-                                else if (strcmp(escolha, "Ejetar") == 0) SDL_Log("Ação: Ejetar cartucho");
-                                else openModalWithTitle(&modal, escolha);
-                            } else if (menuSelecionado == 1) {
-                                if (strcmp(escolha, "Fullscreen") == 0) {
-                                    toggleFullscreen(window);
-                                } else openModalWithTitle(&modal, escolha);
-                            } else if (menuSelecionado == 2) {
-                                if (strcmp(escolha, "Reiniciar") == 0) SDL_Log("Ação: Reiniciar sistema (placeholder)");
-                                else if (strcmp(escolha, "Salvar Estado") == 0) SDL_Log("Ação: Salvar estado (placeholder)");
-                                else if (strcmp(escolha, "Carregar Estado") == 0) SDL_Log("Ação: Carregar estado (placeholder)");
-                            } else if (menuSelecionado == 3) {
-                                // outros itens do menu Áudio (exceto "Volume") continuam funcionando
-                                if (strcmp(escolha, "Mute") == 0) { muted = !muted; SDL_Log("Mute toggled: %d", muted); }
-                                else if (strcmp(escolha, "Mixer") == 0) openModalWithTitle(&modal, escolha);
-                            } else if (menuSelecionado == 4) {
-                                if (strcmp(escolha, "Tema") == 0) {
-                                    openModalWithTitle(&modal, "Tema");
-                                } else {
-                                    openModalWithTitle(&modal, escolha);
-                                }
-                            } else if (menuSelecionado == 5) openModalWithTitle(&modal, escolha);
-
-                            // fechar menu, exceto quando clicamos (ou ignoramos) em "Volume"
-                            if (!(menuSelecionado == 3 && escolha && strcmp(escolha, "Volume") == 0)) menuSelecionado = -1;
-                        }
+                // clique fora do dropdown aberto fecha o menu
+                if (WID_BASE(id) != WID_DROP) {
+                    menuSelecionado = -1;
+                    continue;
+                }
+
+                // item do dropdown: ação pelo ID
+                const char* escolha = allDropdowns[menuSelecionado][idx];
+                switch (action) {
+                case ACT_QUIT: running = 0; break;
+                case ACT_CART_INSERT:
+                    // --rom FILE ainda não inserido: usar; senão pedir para arrastar a ROM
+                    if (opt_rom) {
+                        cart_insert(&cart, opt_rom);
+                        opt_rom = NULL;
                     } else {
-                        menuSelecionado = -1;
-                        volumeDropdownOpen = 0;
+                        openModalWithTitle(&modal, escolha);
+                    }
+                    break;
+                case ACT_LIBRARY:
+                    library_scan(&library);
+                    openModalWithTitle(&modal, escolha);
+                    break;
+                case ACT_CART_EJECT:
+                    if (cart.data) cart_eject(&cart);
+                    else SDL_Log("Ação: Ejetar (nenhum cartucho)");
+                    break;
+                case ACT_FULLSCREEN: toggleFullscreen(window); break;
+                case ACT_RESET: SDL_Log("Ação: Reiniciar sistema (placeholder)"); break;
+                case ACT_SAVE_STATE: state_save(&stateWriter, &simClock, 0); break;
+                case ACT_LOAD_STATE:
+                    if (state_load(&stateWriter, &simClock, 0)) {
+                        comp_invalidate(&compositor); // fundo do estado (SCRN) na tela toda
+                        frame_dirty = 1;
                     }
+                    break;
+                case ACT_MUTE: muted = !muted; SDL_Log("Mute toggled: %d", muted); break;
+                case ACT_VOLUME: break;
+                case ACT_MODAL: openModalWithTitle(&modal, escolha); break;
                 }
+                menuSelecionado = -1;
             }
         } // fim do loop de eventos
+        PROF_END(pz_events, "events");
 
         // detect fullscreen change and mark recreate only if size actually changed
         {
             Uint32 flags_now = SDL_GetWindowFlags(window);
             int now_fullscreen = (flags_now & SDL_WINDOW_FULLSCREEN_DESKTOP) ? 1 : 0;
             if (now_fullscreen != prev_fullscreen) {
+                invalidateMenuLayout(); // espaçamento muda entre janela e fullscreen
                 int w, h; SDL_GetWindowSize(window, &w, &h);
                 if (w != last_w || h != last_h) {
                     last_w = w; last_h = h;
@@ -968,139 +5591,142 @@ int main(int argc, char* argv[]) {
             }
         }
 
-        if (need_recreate) {
-            if (!recreateTextureAndBufferFromWindow(window, renderer)) {
-                SDL_Log("Falha ao recriar texture/buffer");
-            }
-            need_recreate = 0;
-        }
-
         // ---------- RENDER (idle texture + UI) ----------
-        // 1) preencher pixels com a idle animation (usando colorAnims e currentTheme)
-        if (pixels && texture) {
-            // parâmetros locais
-            const float intensity = currentTheme.idle_intensity; // escala base
-            const float gain = currentTheme.idle_gain;           // punch
-
-            // --- remap anims por tema (dinâmico) ---
-            float animR[3], animG[3], animB[3];
-
-            if (strcmp(currentTheme.name, "Dark Default") == 0) {
-                // comportamento para Dark (mapeamento original)
-                get_anim_color(&colorAnims[2], animR); // anim 2 -> R
-                get_anim_color(&colorAnims[1], animG); // anim 1 -> G
-                get_anim_color(&colorAnims[0], animB); // anim 0 -> B
-            } else {
-                // comportamento para Light (inverte R <-> B)
-                get_anim_color(&colorAnims[0], animR); // anim 0 -> R
-                get_anim_color(&colorAnims[1], animG); // anim 1 -> G
-                get_anim_color(&colorAnims[2], animB); // anim 2 -> B
-            }
-            // --- fim remap ---
+        // 2) esperar o sweep, destravar (upload pelo SDL) e desenhar como fundo
+        if (sweep_pending) {
+            PROF_BEGIN(pz_wait);
+            pool_wait(pool);
+            PROF_END(pz_wait, "sweep wait");
+            // eventos tratados entre submit e join não contam como custo do sweep
+            sweep_ms = sweep_wall_ms(&sweepJob);
+            perfHud.sweep_ms = sweep_ms;
+            perfHud.sweep_cpu_ms = (float)SDL_AtomicSet(&sweep_cpu_us, 0) / 1000.0f;
+            PROF_BEGIN(pz_upload);
+            SDL_UnlockTexture(sweepTexture);
+            PROF_END(pz_upload, "texture upload");
+            bgReadyIndex = bgTextureIndex;
+            bgTextureIndex = (bgTextureIndex + 1) % BG_TEXTURE_COUNT;
+        }
 
-            // precompute accent tint (0..1)
-            float ar = currentTheme.accent.r;
-            float ag = currentTheme.accent.g;
-            float ab = currentTheme.accent.b;
-
-            // preencher pixels (procedural sweep)
-            for (int y = 0; y < drawable_h; ++y) {
-                float fy = (float)y / (float)(drawable_h > 1 ? drawable_h - 1 : 1);
-                for (int x = 0; x < drawable_w; ++x) {
-                    float fx = (float)x / (float)(drawable_w > 1 ? drawable_w - 1 : 1);
-
-                    // combine anim channels with position to create smooth sweep
-                    float v0 = 0.5f + 0.5f * sinf((fx + animR[0]*0.5f + fy*0.3f) * 6.2831853f + animR[1]*2.0f);
-                    float v1 = 0.5f + 0.5f * sinf((fx*1.2f + animG[1]*0.6f + fy*0.2f) * 6.2831853f + animG[2]*1.5f);
-                    float v2 = 0.5f + 0.5f * sinf((fx*0.8f + animB[2]*0.4f + fy*0.1f) * 6.2831853f + animB[0]*2.2f);
-
-                    // base color from anims (note mapping: animR/animG/animB)
-                    float rr = (v0 * animR[0] + v1 * animG[0] + v2 * animB[0]) / 3.0f;
-                    float gg = (v0 * animR[1] + v1 * animG[1] + v2 * animB[1]) / 3.0f;
-                    float bb = (v0 * animR[2] + v1 * animG[2] + v2 * animB[2]) / 3.0f;
-
-                    // apply accent tint (subtle) and theme intensity/gain
-                    rr = lerp_f(rr, ar, 0.18f) * intensity;
-                    gg = lerp_f(gg, ag, 0.18f) * intensity;
-                    bb = lerp_f(bb, ab, 0.18f) * intensity;
-
-                    // optional punch: add small bright pulses based on x,y and gain
-                    float pulse = (0.5f + 0.5f * sinf((fx + fy) * 12.0f + animR[0]*6.0f)) * 0.06f * gain;
-                    rr = rr + pulse;
-                    gg = gg + pulse;
-                    bb = bb + pulse;
-
-                    Uint8 R = fcol_to_u8(rr);
-                    Uint8 G = fcol_to_u8(gg);
-                    Uint8 B = fcol_to_u8(bb);
-                    Uint8 A = 255;
-
-                    // ARGB8888 in memory
-                    pixels[y * drawable_w + x] = (A << 24) | (R << 16) | (G << 8) | (B);
-                }
-            }
+        // workers parados: seguro zerar/exportar os rings
+        if (prof_toggle) {
+            prof_toggle = 0;
+            if (SDL_AtomicGet(&prof_enabled)) prof_stop(); else prof_start();
+        }
 
-            // 2) atualizar texture com pixels e desenhar como fundo
-            SDL_UpdateTexture(texture, NULL, pixels, drawable_w * sizeof(Uint32));
-            SDL_Rect dst = {0, 0, win_w, win_h};
-            SDL_RenderCopy(renderer, texture, NULL, &dst);
+        Uint32 st = modal_live_stamp(&modal);
+        if (st != live_stamp) { live_stamp = st; frame_dirty = 1; }
+
+        // Economia: sem fundo novo e sem input não há nada a apresentar
+        if (window_hidden || (renderModeIndex == 1 && !sweep_pending && !frame_dirty)) continue;
+        frame_dirty = 0;
+
+        // Economia: compor no target só o que mudou. Contínuo troca o fundo todo frame,
+        // então desenha direto no backbuffer.
+        int bg_new = sweep_pending || (use_bake && (renderModeIndex == 0 || bake_step)) || use_bake != last_use_bake;
+        last_use_bake = use_bake;
+        int composing = 0;
+        UiDamageState ui_now;
+        ui_damage_capture(&ui_now, &uiAtlas);
+        Uint64 ui_t0 = SDL_GetPerformanceCounter();
+        // layer da UI antes de entrar no target do compositor (troca de render target)
+        int ui_retained = ui_layer_update(&uiLayer, renderer, &uiAtlas, &ui_now);
+        if (renderModeIndex == 1) {
+            if (bg_new) comp_invalidate(&compositor);
+            else comp_track_ui(&compositor, &ui_prev, &ui_now);
+            memcpy(&ui_prev, &ui_now, sizeof(ui_now));
+            // nada visível mudou (ex.: mouse parado sobre o mesmo item): sem present
+            if (compositor.target && !compositor.full && compositor.count == 0 && !perfHud.visible) continue;
+            composing = comp_begin(&compositor, renderer, win_w, win_h);
         } else {
-            // fallback: limpar com background theme se texture/pixels não existirem
-            SDL_SetRenderDrawColor(renderer,
-                                   fcol_to_u8(currentTheme.background.r),
-                                   fcol_to_u8(currentTheme.background.g),
-                                   fcol_to_u8(currentTheme.background.b),
-                                   fcol_to_u8(currentTheme.background.a));
-            SDL_RenderClear(renderer);
+            ui_prev.valid = 0;
         }
 
-        // agora desenhar UI por cima
-        drawMenuBar(renderer, font);
-
-        // draw dropdown if open
-        if (menuSelecionado != -1) {
-            int dx = menuBoxes[menuSelecionado].x;
-            int dy = MENU_HEIGHT;
-            int width = menuBoxes[menuSelecionado].w; if (width < DROPDOWN_MIN_WIDTH) width = DROPDOWN_MIN_WIDTH;
-            int draw_dx = calc_draw_x(dx, width);
-            drawDropdown(renderer, font, allDropdowns[menuSelecionado], dropdownCounts[menuSelecionado], draw_dx, dy, width);
-
-            // if audio menu and volumeDropdownOpen, draw subbox
-            if (menuSelecionado == 3 && volumeDropdownOpen) {
-                int vdx = draw_dx + width;
-                int vdy = dy;
-                int vwidth = VOLUME_SUB_WIDTH;
-                if (vdx + vwidth > win_w - EDGE_MARGIN) vdx = draw_dx - vwidth;
-                if (vdx < EDGE_MARGIN) vdx = EDGE_MARGIN;
-                // draw subbox background using panel color
+        // redesenho parcial mantém os keyframes do último frame completo (já estão nas texturas)
+        if (use_bake && (!composing || compositor.full)) last_bake_pos = bake_pos;
+
+        int passes = composing ? comp_pass_count(&compositor) : 1;
+        for (int pass = 0; pass < passes; ++pass) {
+            if (composing) comp_pass_clip(&compositor, renderer, pass);
+            if (use_bake) {
+                PROF_BEGIN(pz);
+                SDL_Rect dst = {0, 0, win_w, win_h};
+                bg_baker_draw(&bgBaker, renderer, last_bake_pos, &dst);
+                PROF_END(pz, "background keyframes");
+            } else if (bgReadyIndex >= 0 && bgTextures[bgReadyIndex]) {
+                PROF_BEGIN(pz);
+                SDL_Rect dst = {0, 0, win_w, win_h};
+                SDL_RenderCopy(renderer, bgTextures[bgReadyIndex], NULL, &dst);
+                PROF_END(pz, "background copy");
+            } else {
+                // fallback: limpar com background theme se as texturas não existirem
                 SDL_SetRenderDrawColor(renderer,
-                                       fcol_to_u8(currentTheme.panel.r),
-                                       fcol_to_u8(currentTheme.panel.g),
-                                       fcol_to_u8(currentTheme.panel.b),
-                                       fcol_to_u8(currentTheme.panel.a));
-                SDL_Rect vRect = {vdx, vdy, vwidth, DROPDOWN_ITEM_HEIGHT * volumeCount};
-                SDL_RenderFillRect(renderer, &vRect);
-                // draw items
-                drawDropdown(renderer, font, volumeItems, volumeCount, vdx, vdy, vwidth);
+                                       fcol_to_u8(currentTheme.background.r),
+                                       fcol_to_u8(currentTheme.background.g),
+                                       fcol_to_u8(currentTheme.background.b),
+                                       fcol_to_u8(currentTheme.background.a));
+                if (composing && !compositor.full) SDL_RenderFillRect(renderer, &compositor.rects[pass]);
+                else SDL_RenderClear(renderer);
             }
+
+            // agora desenhar UI por cima (uma cópia do layer retido)
+            if (ui_retained) ui_layer_draw(&uiLayer, renderer);
+            else drawUi(renderer, &uiAtlas);
         }
+        if (composing) comp_end(&compositor, renderer);
+        perfHud.ui_ms = (float)((SDL_GetPerformanceCounter() - ui_t0) * perf_ms);
 
-        // draw modal if open
-        drawModal(renderer, font, &modal);
+        // HUD (F3) fora da medição da UI
+        drawPerfHud(renderer, &uiAtlas, &perfHud);
 
-        // draw volume indicator
-        drawVolumeIndicator(renderer, font);
+        // sem vsync, segurar o present até o deadline do frame (período do monitor)
+        PROF_BEGIN(pz_pacer);
+        if (!vsyncIndex) frame_pacer_wait(&pacer);
+        PROF_END(pz_pacer, "pacer wait");
 
+        PROF_BEGIN(pz_present);
+        Uint64 present_t0 = SDL_GetPerformanceCounter();
         SDL_RenderPresent(renderer);
+        float present_ms = (float)((SDL_GetPerformanceCounter() - present_t0) * perf_ms);
+        PROF_END(pz_present, "SDL_RenderPresent");
+        perf_hud_present(&perfHud, SDL_GetPerformanceCounter(), perf_ms);
+        perfHud.rasters = text_raster_count;
+        perfHud.rewind_on = rewindRing.enabled;
+        if (rewindRing.enabled && perfHud.visible) {
+            size_t bytes;
+            int dropped;
+            rewind_stats(&rewindRing, &perfHud.rewind_seconds, &bytes, &dropped);
+            perfHud.rewind_mb = (float)bytes / (1024.0f * 1024.0f);
+        }
+        perfHud.rewind_capture_us = rewindRing.capture_us;
+        perfHud.runahead_frames = runAheadIndex;
+        perfHud.runahead_us = runAhead.cost_us;
+        text_raster_count = 0;
+
+        // modo Auto: ajustar a escala do fundo para o próximo frame.
+        // Com vsync o present inclui a espera pelo retrace, que não é custo de render.
+        if (sweep_pending && dynres_update(&dynRes, dynResBudgets[dynResIndex], sweep_ms, vsyncIndex ? 0.0f : present_ms)) need_recreate = 1;
 
-        // small delay to cap CPU (tweak as needed)
-        SDL_Delay(8);
+        PROF_END(pz_frame, "frame");
         frame++;
     }
 
     // cleanup
-    if (pixels) free(pixels);
-    if (texture) SDL_DestroyTexture(texture);
+    state_writer_destroy(&stateWriter); // termina a gravação pendente
+    rewind_destroy(&rewindRing);
+    run_ahead_destroy(&runAhead);
+    library_destroy(&library);
+    cart_eject(&cart);
+    hit_index_free(&hitIndex);
+    ui_layer_destroy(&uiLayer);
+    comp_destroy(&compositor);
+    bg_baker_destroy(&bgBaker);
+    pool_destroy(pool);
+    prof_shutdown();
+    sweep_tables_free(&sweepTables);
+    text_cache_clear(&uiTextCache);
+    glyph_atlas_destroy(&uiAtlas);
+    destroyBackgroundTextures();
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     TTF_Quit();